@@ -37,11 +37,16 @@ function Readability(doc, options) {
 
   this._doc = doc;
   this._docJSDOMParser = this._doc.firstChild.__JSDOMParser__;
+  // qreadable documents provide native implementations of some of the
+  // work done here; see CLASSIFIER_FLAGS.
+  this._docQReadable = !!this._doc.qreadable;
   this._articleTitle = null;
   this._articleByline = null;
   this._articleDir = null;
   this._articleSiteName = null;
   this._attempts = [];
+  // passes made by _grabArticle, for Readable's parse stats
+  this._grabArticlePasses = 0;
 
   // Configurable options
   this._debug = !!options.debug;
@@ -144,6 +149,19 @@ Readability.prototype = {
     jsonLdArticleTypes: /^Article|AdvertiserContentArticle|NewsArticle|AnalysisNewsArticle|AskPublicNewsArticle|BackgroundNewsArticle|OpinionNewsArticle|ReportageNewsArticle|ReviewNewsArticle|Report|SatiricalArticle|ScholarlyArticle|MedicalScholarlyArticle|SocialMediaPosting|BlogPosting|LiveBlogPosting|DiscussionForumPosting|TechArticle|APIReference$/
   },
 
+  // Bits of Element.classifierFlags on qreadable documents, keyed by the
+  // REGEXPS they stand in for. These must match QReadable::Classifier::Flag.
+  CLASSIFIER_FLAGS: {
+    unlikelyCandidates: 0x01,
+    okMaybeItsACandidate: 0x02,
+    byline: 0x04,
+    shareElements: 0x08,
+    positiveClass: 0x10,
+    negativeClass: 0x20,
+    positiveId: 0x40,
+    negativeId: 0x80,
+  },
+
   UNLIKELY_ROLES: [ "menu", "menubar", "complementary", "navigation", "alert", "alertdialog", "dialog" ],
 
   DIV_TO_P_ELEMS: new Set([ "BLOCKQUOTE", "DL", "DIV", "IMG", "OL", "P", "PRE", "TABLE", "UL" ]),
@@ -333,6 +351,11 @@ Readability.prototype = {
    */
   _cleanClasses: function(node) {
     var classesToPreserve = this._classesToPreserve;
+    if (this._docQReadable) {
+      // cleans the whole subtree in one call
+      node.cleanClasses(classesToPreserve);
+      return;
+    }
     var className = (node.getAttribute("class") || "")
       .split(/\s+/)
       .filter(function(cls) {
@@ -376,7 +399,11 @@ Readability.prototype = {
       return uri;
     }
 
-    var links = this._getAllNodesWithTag(articleContent, ["a"]);
+    // qreadable documents resolve every URI natively, and return only
+    // the javascript: links, which are unwrapped below
+    var links = this._docQReadable ?
+      this._doc.resolveRelativeUris(articleContent) :
+      this._getAllNodesWithTag(articleContent, ["a"]);
     this._forEachNode(links, function(link) {
       var href = link.getAttribute("href");
       if (href) {
@@ -390,9 +417,7 @@ Readability.prototype = {
           } else {
             // if the link has multiple children, they should all be preserved
             var container = this._doc.createElement("span");
-            while (link.firstChild) {
-              container.appendChild(link.firstChild);
-            }
+            this._moveChildren(link, container);
             link.parentNode.replaceChild(container, link);
           }
         } else {
@@ -401,6 +426,10 @@ Readability.prototype = {
       }
     });
 
+    if (this._docQReadable) {
+      return;
+    }
+
     var medias = this._getAllNodesWithTag(articleContent, [
       "img", "picture", "figure", "video", "audio", "source"
     ]);
@@ -573,30 +602,43 @@ Readability.prototype = {
    */
   _replaceBrs: function (elem) {
     this._forEachNode(this._getAllNodesWithTag(elem, ["br"]), function(br) {
-      var next = br.nextSibling;
-
-      // Whether 2 or more <br> elements have been found and replaced with a
-      // <p> block.
-      var replaced = false;
-
-      // If we find a <br> chain, remove the <br>s until we hit another node
-      // or non-whitespace. This leaves behind the first <br> in the chain
-      // (which will be replaced with a <p> later).
-      while ((next = this._nextNode(next)) && (next.tagName == "BR")) {
-        replaced = true;
-        var brSibling = next.nextSibling;
-        next.parentNode.removeChild(next);
-        next = brSibling;
-      }
+      // Only a <br> that starts a chain of 2 or more needs work. The first
+      // such <br> in an element replaces all of that element's chains, so
+      // later ones have already been removed.
+      var next = this._nextNode(br.nextSibling);
+      if (!next || next.tagName != "BR")
+        return;
 
-      // If we removed a <br> chain, replace the remaining <br> with a <p>. Add
-      // all sibling nodes as children of the <p> until we hit another <br>
-      // chain.
-      if (replaced) {
+      // Take the children from this <br> on out and put them back in order,
+      // so that each one is moved from the front of a list.
+      var parent = br.parentNode;
+      var rest = this._doc.createElement("div");
+      this._moveChildren(parent, rest, br);
+      var child;
+      while ((child = rest.firstChild)) {
+        // If we find a <br> chain, remove the <br>s until we hit another node
+        // or non-whitespace. This leaves behind the first <br> in the chain
+        // (which will be replaced with a <p> later).
+        var replaced = false;
+        next = child.nextSibling;
+        while (child.tagName == "BR" && (next = this._nextNode(next)) && (next.tagName == "BR")) {
+          replaced = true;
+          var brSibling = next.nextSibling;
+          rest.removeChild(next);
+          next = brSibling;
+        }
+        if (!replaced) {
+          parent.appendChild(child);
+          continue;
+        }
+
+        // Replace the remaining <br> with a <p>. Add all sibling nodes as
+        // children of the <p> until we hit another <br> chain.
         var p = this._doc.createElement("p");
-        br.parentNode.replaceChild(p, br);
+        rest.removeChild(child);
+        parent.appendChild(p);
 
-        next = p.nextSibling;
+        next = rest.firstChild;
         while (next) {
           // If we've hit another <br><br>, we're done adding children to this <p>.
           if (next.tagName == "BR") {
@@ -608,18 +650,19 @@ Readability.prototype = {
           if (!this._isPhrasingContent(next))
             break;
 
-          // Otherwise, make this node a child of the new <p>.
-          var sibling = next.nextSibling;
-          p.appendChild(next);
-          next = sibling;
+          next = next.nextSibling;
         }
 
+        // Otherwise, make the nodes before it children of the new <p>.
+        if (rest.firstChild)
+          this._moveChildren(rest, p, rest.firstChild, next);
+
         while (p.lastChild && this._isWhitespace(p.lastChild)) {
           p.removeChild(p.lastChild);
         }
 
-        if (p.parentNode.tagName === "P")
-          this._setNodeTag(p.parentNode, "DIV");
+        if (parent.tagName === "P")
+          parent = this._setNodeTag(parent, "DIV");
       }
     });
   },
@@ -631,6 +674,9 @@ Readability.prototype = {
       node.tagName = tag.toUpperCase();
       return node;
     }
+    if (this._docQReadable) {
+      return node.renameTag(tag);
+    }
 
     var replacement = node.ownerDocument.createElement(tag);
     while (node.firstChild) {
@@ -655,6 +701,28 @@ Readability.prototype = {
     return replacement;
   },
 
+  /**
+   * Moves node's children, or only those from first up to but not
+   * including end, to the end of target's children.
+   *
+   * @param Element node
+   * @param Element target
+   * @param Node first (optional)
+   * @param Node end (optional)
+   */
+  _moveChildren: function (node, target, first, end) {
+    if (this._docQReadable) {
+      node.moveChildrenTo(target, first || null, end || null);
+      return;
+    }
+    var child = first || node.firstChild;
+    while (child && child !== end) {
+      var next = child.nextSibling;
+      target.appendChild(child);
+      child = next;
+    }
+  },
+
   /**
    * Prepare the article node for display. Clean out any inline styles,
    * iframes, forms, strip extraneous <p> tags, etc.
@@ -688,7 +756,7 @@ Readability.prototype = {
 
     this._forEachNode(articleContent.children, function (topCandidate) {
       this._cleanMatchedNodes(topCandidate, function (node, matchString) {
-        return this.REGEXPS.shareElements.test(matchString) && node.textContent.length < shareElementThreshold;
+        return this._classMatches(node, matchString, "shareElements") && node.textContent.length < shareElementThreshold;
       });
     });
 
@@ -832,6 +900,23 @@ Readability.prototype = {
     return 1 - distanceB;
   },
 
+  /**
+   * Tests a node's className + " " + id against one of the REGEXPS that
+   * have a CLASSIFIER_FLAGS entry. On qreadable documents the result is
+   * precomputed natively for each element.
+   *
+   * @param Element
+   * @param string className + " " + id of the node
+   * @param string name of the regexp in REGEXPS
+   * @return Boolean
+   */
+  _classMatches: function(node, matchString, regexpName) {
+    if (this._docQReadable) {
+      return (node.classifierFlags & this.CLASSIFIER_FLAGS[regexpName]) !== 0;
+    }
+    return this.REGEXPS[regexpName].test(matchString);
+  },
+
   _checkByline: function(node, matchString) {
     if (this._articleByline) {
       return false;
@@ -842,7 +927,7 @@ Readability.prototype = {
       var itemprop = node.getAttribute("itemprop");
     }
 
-    if ((rel === "author" || (itemprop && itemprop.indexOf("author") !== -1) || this.REGEXPS.byline.test(matchString)) && this._isValidByline(node.textContent)) {
+    if ((rel === "author" || (itemprop && itemprop.indexOf("author") !== -1) || this._classMatches(node, matchString, "byline")) && this._isValidByline(node.textContent)) {
       this._articleByline = node.textContent.trim();
       return true;
     }
@@ -885,6 +970,7 @@ Readability.prototype = {
 
     while (true) {
       this.log("Starting grabArticle loop");
+      this._grabArticlePasses++;
       var stripUnlikelyCandidates = this._flagIsActive(this.FLAG_STRIP_UNLIKELYS);
 
       // First, node prepping. Trash nodes that look cruddy (like ones with the
@@ -924,8 +1010,8 @@ Readability.prototype = {
 
         // Remove unlikely candidates
         if (stripUnlikelyCandidates) {
-          if (this.REGEXPS.unlikelyCandidates.test(matchString) &&
-              !this.REGEXPS.okMaybeItsACandidate.test(matchString) &&
+          if (this._classMatches(node, matchString, "unlikelyCandidates") &&
+              !this._classMatches(node, matchString, "okMaybeItsACandidate") &&
               !this._hasAncestorTag(node, "table") &&
               !this._hasAncestorTag(node, "code") &&
               node.tagName !== "BODY" &&
@@ -958,25 +1044,34 @@ Readability.prototype = {
         // Turn all divs that don't have children block level elements into p's
         if (node.tagName === "DIV") {
           // Put phrasing content into paragraphs.
-          var p = null;
           var childNode = node.firstChild;
-          while (childNode) {
-            var nextSibling = childNode.nextSibling;
-            if (this._isPhrasingContent(childNode)) {
-              if (p !== null) {
-                p.appendChild(childNode);
-              } else if (!this._isWhitespace(childNode)) {
-                p = doc.createElement("p");
-                node.replaceChild(p, childNode);
-                p.appendChild(childNode);
+          while (childNode && (!this._isPhrasingContent(childNode) || this._isWhitespace(childNode))) {
+            childNode = childNode.nextSibling;
+          }
+          if (childNode) {
+            // Take the children from the first paragraph on out and put them
+            // back in order, so that each one is moved from the front of a list.
+            var rest = doc.createElement("div");
+            this._moveChildren(node, rest, childNode);
+            while ((childNode = rest.firstChild)) {
+              if (!this._isPhrasingContent(childNode) || this._isWhitespace(childNode)) {
+                node.appendChild(childNode);
+                continue;
+              }
+              // The paragraph runs up to the next non-phrasing node.
+              var end = childNode.nextSibling;
+              while (end && this._isPhrasingContent(end)) {
+                end = end.nextSibling;
               }
-            } else if (p !== null) {
-              while (p.lastChild && this._isWhitespace(p.lastChild)) {
-                p.removeChild(p.lastChild);
+              var p = doc.createElement("p");
+              node.appendChild(p);
+              this._moveChildren(rest, p, childNode, end);
+              if (end) {
+                while (p.lastChild && this._isWhitespace(p.lastChild)) {
+                  p.removeChild(p.lastChild);
+                }
               }
-              p = null;
             }
-            childNode = nextSibling;
           }
 
           // Sites like http://mobile.slate.com encloses each paragraph with a DIV
@@ -1090,10 +1185,8 @@ Readability.prototype = {
         neededToCreateTopCandidate = true;
         // Move everything (not just elements, also text nodes etc.) into the container
         // so we even include text directly in the body:
-        while (page.firstChild) {
-          this.log("Moving child out:", page.firstChild);
-          topCandidate.appendChild(page.firstChild);
-        }
+        this.log("Moving children out:", page);
+        this._moveChildren(page, topCandidate);
 
         page.appendChild(topCandidate);
 
@@ -1253,9 +1346,7 @@ Readability.prototype = {
         var div = doc.createElement("DIV");
         div.id = "readability-page-1";
         div.className = "page";
-        while (articleContent.firstChild) {
-          div.appendChild(articleContent.firstChild);
-        }
+        this._moveChildren(articleContent, div);
         articleContent.appendChild(div);
       }
 
@@ -1360,10 +1451,24 @@ Readability.prototype = {
    * @return Object with any metadata that could be extracted (possibly none)
    */
   _getJSONLD: function (doc) {
-    var scripts = this._getAllNodesWithTag(doc, ["script"]);
-
     var metadata;
 
+    if (this._docQReadable && doc.metadataCaptured) {
+      // the document found the article object as it was built
+      var article = doc.jsonLd;
+      if (article) {
+        try {
+          metadata = {};
+          this._readJSONLDArticle(article, metadata);
+        } catch (err) {
+          this.log(err.message);
+        }
+      }
+      return metadata ? metadata : {};
+    }
+
+    var scripts = this._getAllNodesWithTag(doc, ["script"]);
+
     this._forEachNode(scripts, function(jsonLdElement) {
       if (!metadata && jsonLdElement.getAttribute("type") === "application/ld+json") {
         try {
@@ -1394,49 +1499,7 @@ Readability.prototype = {
           }
 
           metadata = {};
-
-          if (typeof parsed.name === "string" && typeof parsed.headline === "string" && parsed.name !== parsed.headline) {
-            // we have both name and headline element in the JSON-LD. They should both be the same but some websites like aktualne.cz
-            // put their own name into "name" and the article title to "headline" which confuses Readability. So we try to check if either
-            // "name" or "headline" closely matches the html title, and if so, use that one. If not, then we use "name" by default.
-
-            var title = this._getArticleTitle();
-            var nameMatches = this._textSimilarity(parsed.name, title) > 0.75;
-            var headlineMatches = this._textSimilarity(parsed.headline, title) > 0.75;
-
-            if (headlineMatches && !nameMatches) {
-              metadata.title = parsed.headline;
-            } else {
-              metadata.title = parsed.name;
-            }
-          } else if (typeof parsed.name === "string") {
-            metadata.title = parsed.name.trim();
-          } else if (typeof parsed.headline === "string") {
-            metadata.title = parsed.headline.trim();
-          }
-          if (parsed.author) {
-            if (typeof parsed.author.name === "string") {
-              metadata.byline = parsed.author.name.trim();
-            } else if (Array.isArray(parsed.author) && parsed.author[0] && typeof parsed.author[0].name === "string") {
-              metadata.byline = parsed.author
-                .filter(function(author) {
-                  return author && typeof author.name === "string";
-                })
-                .map(function(author) {
-                  return author.name.trim();
-                })
-                .join(", ");
-            }
-          }
-          if (typeof parsed.description === "string") {
-            metadata.excerpt = parsed.description.trim();
-          }
-          if (
-            parsed.publisher &&
-            typeof parsed.publisher.name === "string"
-          ) {
-            metadata.siteName = parsed.publisher.name.trim();
-          }
+          this._readJSONLDArticle(parsed, metadata);
           return;
         } catch (err) {
           this.log(err.message);
@@ -1446,6 +1509,55 @@ Readability.prototype = {
     return metadata ? metadata : {};
   },
 
+  /**
+   * Copies the title, byline, excerpt and site name of a JSON-LD
+   * article object into metadata.
+   */
+  _readJSONLDArticle: function(parsed, metadata) {
+    if (typeof parsed.name === "string" && typeof parsed.headline === "string" && parsed.name !== parsed.headline) {
+      // we have both name and headline element in the JSON-LD. They should both be the same but some websites like aktualne.cz
+      // put their own name into "name" and the article title to "headline" which confuses Readability. So we try to check if either
+      // "name" or "headline" closely matches the html title, and if so, use that one. If not, then we use "name" by default.
+
+      var title = this._getArticleTitle();
+      var nameMatches = this._textSimilarity(parsed.name, title) > 0.75;
+      var headlineMatches = this._textSimilarity(parsed.headline, title) > 0.75;
+
+      if (headlineMatches && !nameMatches) {
+        metadata.title = parsed.headline;
+      } else {
+        metadata.title = parsed.name;
+      }
+    } else if (typeof parsed.name === "string") {
+      metadata.title = parsed.name.trim();
+    } else if (typeof parsed.headline === "string") {
+      metadata.title = parsed.headline.trim();
+    }
+    if (parsed.author) {
+      if (typeof parsed.author.name === "string") {
+        metadata.byline = parsed.author.name.trim();
+      } else if (Array.isArray(parsed.author) && parsed.author[0] && typeof parsed.author[0].name === "string") {
+        metadata.byline = parsed.author
+          .filter(function(author) {
+            return author && typeof author.name === "string";
+          })
+          .map(function(author) {
+            return author.name.trim();
+          })
+          .join(", ");
+      }
+    }
+    if (typeof parsed.description === "string") {
+      metadata.excerpt = parsed.description.trim();
+    }
+    if (
+      parsed.publisher &&
+      typeof parsed.publisher.name === "string"
+    ) {
+      metadata.siteName = parsed.publisher.name.trim();
+    }
+  },
+
   /**
    * Attempts to get excerpt and byline metadata for the article.
    *
@@ -1456,8 +1568,10 @@ Readability.prototype = {
    */
   _getArticleMetadata: function(jsonld) {
     var metadata = {};
-    var values = {};
-    var metaElements = this._doc.getElementsByTagName("meta");
+    // qreadable documents collect the values below as they are built
+    var native = this._docQReadable && this._doc.metadataCaptured;
+    var values = native ? this._doc.metaValues : {};
+    var metaElements = native ? [] : this._doc.getElementsByTagName("meta");
 
     // property is a space-separated list of values
     var propertyPattern = /\s*(dc|dcterm|og|twitter)\s*:\s*(author|creator|description|title|site_name)\s*/gi;
@@ -1746,6 +1860,12 @@ Readability.prototype = {
     if (!e || e.tagName.toLowerCase() === "svg")
       return;
 
+    if (this._docQReadable) {
+      // cleans the whole subtree in one call
+      e.cleanStyles(this.PRESENTATIONAL_ATTRIBUTES, this.DEPRECATED_SIZE_ATTRIBUTE_ELEMS);
+      return;
+    }
+
     // Remove `style` and deprecated presentational attributes
     for (var i = 0; i < this.PRESENTATIONAL_ATTRIBUTES.length; i++) {
       e.removeAttribute(this.PRESENTATIONAL_ATTRIBUTES[i]);
@@ -1800,6 +1920,19 @@ Readability.prototype = {
 
     var weight = 0;
 
+    if (this._docQReadable) {
+      var flags = e.classifierFlags;
+      if (flags & this.CLASSIFIER_FLAGS.negativeClass)
+        weight -= 25;
+      if (flags & this.CLASSIFIER_FLAGS.positiveClass)
+        weight += 25;
+      if (flags & this.CLASSIFIER_FLAGS.negativeId)
+        weight -= 25;
+      if (flags & this.CLASSIFIER_FLAGS.positiveId)
+        weight += 25;
+      return weight;
+    }
+
     // Look for a special classname
     if (typeof(e.className) === "string" && e.className !== "") {
       if (this.REGEXPS.negative.test(e.className))
@@ -1880,6 +2013,10 @@ Readability.prototype = {
    * Return an object indicating how many rows and columns this table has.
    */
   _getRowAndColumnCount: function(table) {
+    if (this._docQReadable) {
+      var shape = table.tableShape;
+      return {rows: shape.rows, columns: shape.columns};
+    }
     var rows = 0;
     var columns = 0;
     var trs = table.getElementsByTagName("tr");
@@ -1914,6 +2051,11 @@ Readability.prototype = {
     var tables = root.getElementsByTagName("table");
     for (var i = 0; i < tables.length; i++) {
       var table = tables[i];
+      // qreadable tables classify themselves in one pass over their contents
+      if (this._docQReadable) {
+        table._readabilityDataTable = table.dataTable;
+        continue;
+      }
       var role = table.getAttribute("role");
       if (role == "presentation") {
         table._readabilityDataTable = false;
@@ -2249,7 +2391,8 @@ Readability.prototype = {
     if (!articleContent)
       return null;
 
-    this.log("Grabbed: " + articleContent.innerHTML);
+    if (this._debug)
+      this.log("Grabbed: " + articleContent.innerHTML);
 
     this._postProcessContent(articleContent);
 
@@ -0,0 +1,130 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "article.h"
+#include <QJSValue>
+#include <QMetaProperty>
+using namespace QReadable;
+
+struct Article::PrivData {
+    QJSValue result;
+    QVariantMap fields;
+};
+
+Article::Article() = default;
+
+Article::Article(const QJSValue &parseResult, Status status)
+    : m_status{status}
+{
+    if (parseResult.isObject()) {
+        d = std::make_shared<PrivData>(PrivData{parseResult, QVariantMap()});
+    }
+}
+
+Article::Article(const QVariantMap &fields, Status status)
+    : m_status{status}
+{
+    if (!fields.isEmpty()) {
+        d = std::make_shared<PrivData>(PrivData{QJSValue(), fields});
+    }
+}
+
+Article::~Article() = default;
+
+bool Article::isNull() const
+{
+    return !d;
+}
+
+Article::Status Article::status() const
+{
+    return m_status;
+}
+
+QString Article::title() const
+{
+    return stringProperty("title");
+}
+
+QString Article::byline() const
+{
+    return stringProperty("byline");
+}
+
+QString Article::dir() const
+{
+    return stringProperty("dir");
+}
+
+QString Article::lang() const
+{
+    return stringProperty("lang");
+}
+
+QString Article::content() const
+{
+    return stringProperty("content");
+}
+
+QString Article::textContent() const
+{
+    return stringProperty("textContent");
+}
+
+int Article::length() const
+{
+    if (!d) {
+        return 0;
+    }
+    if (!d->result.isObject()) {
+        return d->fields.value("length").toInt();
+    }
+    return d->result.property("length").toInt();
+}
+
+QString Article::excerpt() const
+{
+    return stringProperty("excerpt");
+}
+
+QString Article::siteName() const
+{
+    return stringProperty("siteName");
+}
+
+QVariantMap Article::toVariantMap() const
+{
+    if (!d || !d->result.isObject()) {
+        return d ? d->fields : QVariantMap();
+    }
+    QVariantMap fields;
+    const QMetaObject &metaObject = staticMetaObject;
+    for (int i = metaObject.propertyOffset(); i < metaObject.propertyCount(); i++) {
+        QMetaProperty property = metaObject.property(i);
+        if (qstrcmp(property.name(), "status") == 0) {
+            continue;
+        }
+        QVariant value = property.readOnGadget(this);
+        if (value.type() != QVariant::String || !value.toString().isNull()) {
+            fields.insert(QString::fromLatin1(property.name()), value);
+        }
+    }
+    return fields;
+}
+
+QString Article::stringProperty(const char *name) const
+{
+    if (!d) {
+        return QString();
+    }
+    if (!d->result.isObject()) {
+        QVariant value = d->fields.value(QLatin1String(name));
+        return value.type() == QVariant::String ? value.toString() : QString();
+    }
+    QJSValue value = d->result.property(QLatin1String(name));
+    if (!value.isString()) {
+        return QString();
+    }
+    return value.toString();
+}
@@ -0,0 +1,94 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QMetaType>
+#include <QString>
+#include <QVariantMap>
+#include <memory>
+#include "readable-defs.h"
+class QJSValue;
+
+namespace QReadable {
+/**
+ * The article record produced by Readable::parse()
+ *
+ * An Article keeps a reference to the result object returned by
+ * Readability.js, and each field is converted to a C++ value only
+ * when its getter is called.  Fields that are never read, such as the
+ * (potentially large) textContent, are never copied out of the script
+ * engine.
+ *
+ * An Article is only valid for as long as the Readable that produced
+ * it is alive, unless it was made from a field map (see toVariantMap()).
+ *
+ * If a parse was cut short by its ParseLimits or a CancellationToken,
+ * status() says why, and the article may be null or built from only
+ * part of the document.
+ */
+class QREADABLE_EXPORT Article
+{
+    Q_GADGET
+    Q_PROPERTY(QString title READ title)
+    Q_PROPERTY(QString byline READ byline)
+    Q_PROPERTY(QString dir READ dir)
+    Q_PROPERTY(QString lang READ lang)
+    Q_PROPERTY(QString content READ content)
+    Q_PROPERTY(QString textContent READ textContent)
+    Q_PROPERTY(int length READ length)
+    Q_PROPERTY(QString excerpt READ excerpt)
+    Q_PROPERTY(QString siteName READ siteName)
+    Q_PROPERTY(Status status READ status)
+
+public:
+    enum Status {
+        Complete,   ///< the whole document was processed
+        Truncated,  ///< the document exceeded a byte or node budget and only part of it was processed
+        TimedOut,   ///< the parse was stopped because it exceeded its time budget
+        Cancelled,  ///< the parse was stopped by a CancellationToken
+        ReadError   ///< the input file could not be read
+    };
+    Q_ENUM(Status)
+
+    Article();
+    explicit Article(const QJSValue &parseResult, Status status=Complete);
+
+    /**
+     * Create an article from fields returned by toVariantMap().  An empty map gives a null article.
+     */
+    explicit Article(const QVariantMap &fields, Status status=Complete);
+    ~Article();
+
+    /**
+     * True if no article could be extracted from the document
+     */
+    bool isNull() const;
+
+    Status status() const;
+
+    QString title() const;
+    QString byline() const;
+    QString dir() const;
+    QString lang() const;
+    QString content() const;
+    QString textContent() const;
+    int length() const;
+    QString excerpt() const;
+    QString siteName() const;
+
+    /**
+     * Copy every field out of the script engine, keyed by property name
+     */
+    QVariantMap toVariantMap() const;
+
+private:
+    struct PrivData;
+    std::shared_ptr<const PrivData> d;
+    Status m_status{Complete};
+    QString stringProperty(const char *name) const;
+};
+}
+
+Q_DECLARE_METATYPE(QReadable::Article)
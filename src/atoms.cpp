@@ -0,0 +1,75 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "atoms.h"
+#include <QByteArray>
+#include <QHash>
+using namespace QReadable;
+
+namespace {
+struct AtomTable {
+    QString upperTagNames[GUMBO_TAG_LAST + 1];
+    QString lowerTagNames[GUMBO_TAG_LAST + 1];
+    QHash<QString, GumboTag> tagsByName;
+    QHash<QByteArray, QString> attributeNames;
+
+    AtomTable();
+};
+}
+
+// attributes that are common in articles, or that Readability.js looks up
+static const char *const kCommonAttributes[] = {
+    "align", "alt", "aria-hidden", "background", "bgcolor", "border",
+    "cellpadding", "cellspacing", "charset", "class", "colspan", "content",
+    "data-src", "data-srcset", "datetime", "dir", "frame", "height",
+    "hidden", "href", "hspace", "http-equiv", "id", "itemprop", "itemscope",
+    "itemtype", "lang", "loading", "name", "property", "rel", "role",
+    "rowspan", "rules", "sizes", "src", "srcset", "style", "summary",
+    "target", "title", "type", "valign", "vspace", "width",
+};
+
+AtomTable::AtomTable()
+{
+    for (int tag = 0; tag < GUMBO_TAG_UNKNOWN; tag++) {
+        QString name = QString::fromLatin1(gumbo_normalized_tagname(static_cast<GumboTag>(tag)));
+        upperTagNames[tag] = name.toUpper();
+        lowerTagNames[tag] = name;
+        tagsByName.insert(name, static_cast<GumboTag>(tag));
+    }
+    for (const char *name : kCommonAttributes) {
+        // the key refers to the literal, which lives as long as the table
+        attributeNames.insert(QByteArray::fromRawData(name, int(qstrlen(name))), QString::fromLatin1(name));
+    }
+}
+
+static const AtomTable &atomTable()
+{
+    static const AtomTable table;
+    return table;
+}
+
+const QString &Atoms::upperTagName(GumboTag tag)
+{
+    return atomTable().upperTagNames[tag];
+}
+
+const QString &Atoms::lowerTagName(GumboTag tag)
+{
+    return atomTable().lowerTagNames[tag];
+}
+
+GumboTag Atoms::tagForName(const QString &name)
+{
+    return atomTable().tagsByName.value(name.toLower(), GUMBO_TAG_UNKNOWN);
+}
+
+QString Atoms::attributeName(const char *name)
+{
+    const AtomTable &table = atomTable();
+    auto found = table.attributeNames.constFind(QByteArray::fromRawData(name, int(qstrlen(name))));
+    if (found != table.attributeNames.constEnd()) {
+        return found.value();
+    }
+    return QString::fromUtf8(name);
+}
@@ -0,0 +1,39 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include "gumbo/gumbo.h"
+#include <QString>
+
+namespace QReadable {
+/**
+ * Shared strings for tag and attribute names
+ *
+ * The table is built once per process and never modified, so the
+ * strings it returns can be copied on any thread; a copy only takes a
+ * reference rather than allocating.
+ */
+namespace Atoms {
+/**
+ * The upper-case name of \a tag, as returned by Element.tagName
+ */
+const QString &upperTagName(GumboTag tag);
+
+/**
+ * The lower-case name of \a tag, as returned by Element.localName
+ */
+const QString &lowerTagName(GumboTag tag);
+
+/**
+ * The tag named \a name, in any case, or GUMBO_TAG_UNKNOWN
+ */
+GumboTag tagForName(const QString &name);
+
+/**
+ * \a name (a lower-case attribute name from Gumbo), shared if it is a common one
+ */
+QString attributeName(const char *name);
+}
+}
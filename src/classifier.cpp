@@ -0,0 +1,83 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "classifier.h"
+#include <QRegularExpression>
+using namespace QReadable;
+
+namespace {
+// These must be kept in sync with REGEXPS in Readability.js
+struct Patterns {
+    QRegularExpression unlikelyCandidates{
+        "-ad-|ai2html|banner|breadcrumbs|combx|comment|community|cover-wrap|disqus|extra|footer|gdpr|header|legends|menu|related|remark|replies|rss|shoutbox|sidebar|skyscraper|social|sponsor|supplemental|ad-break|agegate|pagination|pager|popup|yom-remote",
+        QRegularExpression::CaseInsensitiveOption};
+    QRegularExpression okMaybeItsACandidate{
+        "and|article|body|column|content|main|shadow",
+        QRegularExpression::CaseInsensitiveOption};
+    QRegularExpression positive{
+        "article|body|content|entry|hentry|h-entry|main|page|pagination|post|text|blog|story",
+        QRegularExpression::CaseInsensitiveOption};
+    QRegularExpression negative{
+        "-ad-|hidden|^hid$| hid$| hid |^hid |banner|combx|comment|com-|contact|foot|footer|footnote|gdpr|masthead|media|meta|outbrain|promo|related|scroll|share|shoutbox|sidebar|skyscraper|sponsor|shopping|tags|tool|widget",
+        QRegularExpression::CaseInsensitiveOption};
+    QRegularExpression byline{
+        "byline|author|dateline|writtenby|p-author",
+        QRegularExpression::CaseInsensitiveOption};
+    QRegularExpression shareElements{
+        "(\\b|_)(share|sharedaddy)(\\b|_)",
+        QRegularExpression::CaseInsensitiveOption};
+
+    Patterns()
+    {
+        for (QRegularExpression *re : {&unlikelyCandidates, &okMaybeItsACandidate, &positive, &negative, &byline, &shareElements}) {
+            re->optimize();
+        }
+    }
+};
+}
+
+static const Patterns &patterns()
+{
+    static const Patterns instance;
+    return instance;
+}
+
+static bool matches(const QRegularExpression &re, const QString &subject)
+{
+    return !subject.isEmpty() && re.match(subject).hasMatch();
+}
+
+int Classifier::classify(const QString &className, const QString &id, int which)
+{
+    const Patterns &p = patterns();
+    int result = 0;
+    if (which & (UnlikelyCandidate | OkMaybeItsACandidate | Byline | ShareElement)) {
+        const QString matchString = className + QLatin1Char(' ') + id;
+        if ((which & UnlikelyCandidate) && matches(p.unlikelyCandidates, matchString)) {
+            result |= UnlikelyCandidate;
+        }
+        if ((which & OkMaybeItsACandidate) && matches(p.okMaybeItsACandidate, matchString)) {
+            result |= OkMaybeItsACandidate;
+        }
+        if ((which & Byline) && matches(p.byline, matchString)) {
+            result |= Byline;
+        }
+        if ((which & ShareElement) && matches(p.shareElements, matchString)) {
+            result |= ShareElement;
+        }
+    }
+    if ((which & PositiveClass) && matches(p.positive, className)) {
+        result |= PositiveClass;
+    }
+    if ((which & NegativeClass) && matches(p.negative, className)) {
+        result |= NegativeClass;
+    }
+    if ((which & PositiveId) && matches(p.positive, id)) {
+        result |= PositiveId;
+    }
+    if ((which & NegativeId) && matches(p.negative, id)) {
+        result |= NegativeId;
+    }
+    return result;
+}
@@ -0,0 +1,33 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QString>
+
+/**
+ * Native versions of the class/id regular expressions in Readability.js
+ *
+ * The patterns are compiled (and JIT-optimized) once per process, and
+ * classify() evaluates the requested set of them in one call.  The flag
+ * values are mirrored in CLASSIFIER_FLAGS in Readability.js.
+ */
+namespace QReadable::Classifier {
+enum Flag {
+    UnlikelyCandidate = 0x01,    ///< REGEXPS.unlikelyCandidates matches className + " " + id
+    OkMaybeItsACandidate = 0x02, ///< REGEXPS.okMaybeItsACandidate matches className + " " + id
+    Byline = 0x04,               ///< REGEXPS.byline matches className + " " + id
+    ShareElement = 0x08,         ///< REGEXPS.shareElements matches className + " " + id
+    PositiveClass = 0x10,        ///< REGEXPS.positive matches className
+    NegativeClass = 0x20,        ///< REGEXPS.negative matches className
+    PositiveId = 0x40,           ///< REGEXPS.positive matches id
+    NegativeId = 0x80,           ///< REGEXPS.negative matches id
+    AllFlags = 0xff
+};
+
+/**
+ * Returns the set of flags in \a which that match the given class and id
+ */
+int classify(const QString &className, const QString &id, int which=AllFlags);
+}
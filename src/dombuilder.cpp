@@ -8,6 +8,7 @@
 #include <QJSValue>
 #include <QStack>
 #include <QUrl>
+#include "atoms.h"
 #include "domsupport.h"
 using namespace QReadable;
 using namespace QReadable::DomSupport;
@@ -17,9 +18,19 @@ struct DomBuilder::PrivData {
     Node *rootNode{nullptr};
     QStack<Element*> elementStack;
     GumboNode *skipNode{nullptr};
+    GumboNode *skippedScript{nullptr};
+    bool skipScripts{false};
     Text *currentText{nullptr};
+    int maxNodes{0};
+    int nodeCount{0};
+    std::function<bool()> shouldStop;
+    bool truncated{false};
+    std::shared_ptr<const void> sourceOwner;
 };
 
+// how many nodes to build between calls to the shouldStop callback
+static constexpr int kStopCheckInterval = 256;
+
 DomBuilder::~DomBuilder() = default;
 
 DomBuilder::DomBuilder(const QString &text)
@@ -28,32 +39,135 @@ DomBuilder::DomBuilder(const QString &text)
 {
 }
 
+DomBuilder::DomBuilder(const QByteArray &utf8data, std::shared_ptr<const void> sourceOwner)
+    : GumboVisitor(utf8data)
+    , d{std::make_unique<PrivData>()}
+{
+    d->sourceOwner = std::move(sourceOwner);
+}
+
 DomBuilder::DomBuilder(const QString &text, GumboTag fragmentContext)
     : GumboVisitor(text, fragmentContext)
     , d{std::make_unique<PrivData>()}
 {}
 
+DomBuilder::DomBuilder(const QByteArray &utf8data, GumboTag fragmentContext)
+    : GumboVisitor(utf8data, fragmentContext)
+    , d{std::make_unique<PrivData>()}
+{}
+
 
 void DomBuilder::buildIntoNode(Node *element)
 {
     d->rootNode = element;
     d->document = dynamic_cast<Document*>(element);
     d->skipNode = d->document ? nullptr : root();
+    if (d->document) {
+        d->document->m_metadataCaptured = true;
+    }
     walk();
 }
 
 Document *DomBuilder::buildDocument(const QUrl &url)
 {
     d->rootNode = d->document = new Document(url.toString());
+    d->document->m_source = data();
+    d->document->m_sourceOwner = d->sourceOwner;
+    d->document->m_metadataCaptured = true;
     walk();
     return d->document;
 }
 
+void DomBuilder::setBudget(int maxNodes, std::function<bool ()> shouldStop)
+{
+    d->maxNodes = maxNodes;
+    d->shouldStop = std::move(shouldStop);
+}
+
+void DomBuilder::setSkipScripts(bool skip)
+{
+    d->skipScripts = skip;
+}
+
+bool DomBuilder::isTruncated() const
+{
+    return d->truncated;
+}
+
+int DomBuilder::nodeCount() const
+{
+    return d->nodeCount;
+}
+
+bool DomBuilder::admitNode()
+{
+    // only a node beyond the budget truncates, so a document that fits exactly is complete
+    if ((d->maxNodes > 0 && d->nodeCount >= d->maxNodes)
+            || (d->shouldStop && d->nodeCount % kStopCheckInterval == 0 && d->shouldStop())) {
+        d->truncated = true;
+        stopWalk();
+        return false;
+    }
+    ++d->nodeCount;
+    return true;
+}
+
+static QString attributeValue(const GumboElement &element, const char *name)
+{
+    const GumboAttribute *attr = gumbo_get_attribute(&element.attributes, name);
+    return attr ? QString::fromUtf8(attr->value) : QString();
+}
+
+static QString childText(const GumboElement &element)
+{
+    QString text;
+    for (unsigned int i = 0; i < element.children.length; i++) {
+        auto *child = static_cast<GumboNode *>(element.children.data[i]);
+        if (child->type == GUMBO_NODE_TEXT || child->type == GUMBO_NODE_WHITESPACE || child->type == GUMBO_NODE_CDATA) {
+            text += QString::fromUtf8(child->v.text.text);
+        }
+    }
+    return text;
+}
+
+static bool insideNoscript(const GumboNode *node)
+{
+    for (const GumboNode *parent = node->parent; parent; parent = parent->parent) {
+        if (parent->type == GUMBO_NODE_ELEMENT && parent->v.element.tag == GUMBO_TAG_NOSCRIPT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Record what Readability.js's _getArticleMetadata() and _getJSONLD() look for.
+// It removes <noscript> elements before it reads <meta> tags.
+void DomBuilder::captureMetadata(GumboNode *node)
+{
+    const GumboElement &element = node->v.element;
+    if (element.tag == GUMBO_TAG_META && !insideNoscript(node)) {
+        d->document->addMetaTag(attributeValue(element, "name"), attributeValue(element, "property"),
+                                attributeValue(element, "content"));
+    } else if (element.tag == GUMBO_TAG_SCRIPT) {
+        const GumboAttribute *type = gumbo_get_attribute(&element.attributes, "type");
+        if (type && qstrcmp(type->value, "application/ld+json") == 0) {
+            d->document->m_jsonLdScripts.append(childText(element));
+        }
+    }
+}
+
 static QString getTagName(GumboStringPiece originalTag)
 {
     gumbo_tag_from_original_text(&originalTag);
-    QString tagName = QString::fromUtf8(originalTag.data, originalTag.length);
-    return tagName.section(':', -1, -1);
+    // drop any namespace prefix
+    const char *end = originalTag.data + originalTag.length;
+    const char *name = originalTag.data;
+    for (const char *c = name; c < end; c++) {
+        if (*c == ':') {
+            name = c + 1;
+        }
+    }
+    return QString::fromUtf8(name, int(end - name));
 }
 
 void DomBuilder::visitElementOpen(GumboNode *node)
@@ -63,6 +177,16 @@ void DomBuilder::visitElementOpen(GumboNode *node)
         return;
     }
     GumboElement &element = node->v.element;
+    if (d->document) {
+        captureMetadata(node);
+        if (d->skipScripts && element.tag == GUMBO_TAG_SCRIPT) {
+            d->skippedScript = node;
+            return;
+        }
+    }
+    if (!admitNode()) {
+        return;
+    }
     Element *domElement = element.tag==GUMBO_TAG_UNKNOWN ?
                 new Element(getTagName(element.original_tag)) :
                 new Element(element.tag);
@@ -70,7 +194,7 @@ void DomBuilder::visitElementOpen(GumboNode *node)
     GumboVector attrs = element.attributes;
     for(unsigned int i=0; i<attrs.length; i++) {
         const GumboAttribute *attr = static_cast<GumboAttribute *>(attrs.data[i]);
-        domElement->setAttribute(attr->name, attr->value);
+        domElement->setAttribute(Atoms::attributeName(attr->name), QString::fromUtf8(attr->value));
     }
 
     if (d->elementStack.isEmpty()) {
@@ -83,7 +207,8 @@ void DomBuilder::visitElementOpen(GumboNode *node)
     if (d->document && element.tag == GUMBO_TAG_BASE) {
         GumboAttribute *href = gumbo_get_attribute(&element.attributes, "href");
         if (href) {
-            d->document->m_baseURI = href->value;
+            // a relative base is relative to the document
+            d->document->m_baseURI = QUrl(d->document->m_url).resolved(QUrl(QString::fromUtf8(href->value)));
         }
     }
     d->elementStack.push(domElement);
@@ -91,10 +216,15 @@ void DomBuilder::visitElementOpen(GumboNode *node)
 
 void DomBuilder::visitText(GumboNode *node)
 {
+    if (d->skippedScript) {
+        return;
+    }
     QString text = node->v.text.text;
     GumboStringPiece rawSource = node->v.text.original_text;
-    auto source = QString::fromUtf8(rawSource.data, rawSource.length);
     if (!d->currentText) {
+        if (!admitNode()) {
+            return;
+        }
         d->currentText = new Text();
         if (d->elementStack.isEmpty()) {
             d->rootNode->appendChild(d->currentText);
@@ -103,7 +233,12 @@ void DomBuilder::visitText(GumboNode *node)
             parent->appendChild(d->currentText);
         }
     }
-    d->currentText->appendTextContent(text, source);
+    if (d->document && d->document == d->rootNode) {
+        // the document keeps the source alive, so the node can refer into it
+        d->currentText->appendTextSource(text, rawSource.data, static_cast<int>(rawSource.length));
+    } else {
+        d->currentText->appendTextContent(text, QString::fromUtf8(rawSource.data, rawSource.length));
+    }
 }
 
 void DomBuilder::visitElementClose(GumboNode *node)
@@ -112,5 +247,9 @@ void DomBuilder::visitElementClose(GumboNode *node)
     if (node == d->skipNode) {
         return;
     }
+    if (node == d->skippedScript) {
+        d->skippedScript = nullptr;
+        return;
+    }
     d->elementStack.pop();
 }
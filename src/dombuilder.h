@@ -6,6 +6,7 @@
 
 #include "gumbovisitor.h"
 #include "domsupport.h"
+#include <functional>
 #include <memory>
 class QString;
 class QJSValue;
@@ -17,7 +18,7 @@ namespace QReadable {
  *
  * \sa DomSupport::Document
  */
-class DomBuilder : public GumboVisitor
+class DomBuilder : public GumboVisitor<DomBuilder>
 {
 public:
     /**
@@ -25,10 +26,27 @@ public:
      */
     explicit DomBuilder(const QString &text);
 
+    /**
+     * Initialize a DomBuilder by parsing an entire UTF-8 encoded HTML document
+     *
+     * \a utf8data is not copied.  Documents built from it keep a reference
+     * to it, along with \a sourceOwner, which can be used to keep alive the
+     * storage behind a QByteArray::fromRawData() array (such as a memory
+     * mapped file).
+     */
+    explicit DomBuilder(const QByteArray &utf8data, std::shared_ptr<const void> sourceOwner=nullptr);
+
     /**
      * Initialize a DomBuilder by parsing an HTML fragment
      */
     DomBuilder(const QString &text, GumboTag fragmentContext);
+
+    /**
+     * Initialize a DomBuilder by parsing a UTF-8 encoded HTML fragment
+     *
+     * \a utf8data is not copied, and must not be modified until the DomBuilder is destroyed.
+     */
+    DomBuilder(const QByteArray &utf8data, GumboTag fragmentContext);
     ~DomBuilder();
 
     /**
@@ -47,12 +65,43 @@ public:
      */
     void buildIntoNode(DomSupport::Node *node);
 
+    /**
+     * Limit the size of the tree that will be built
+     *
+     * Building stops before a node beyond the first \a maxNodes (zero means
+     * no limit), or once \a shouldStop returns true.  \a shouldStop is polled
+     * periodically rather than for every node, so it should be cheap and
+     * thread-safe.  The nodes built so far are kept.
+     */
+    void setBudget(int maxNodes, std::function<bool()> shouldStop=nullptr);
+
+    /**
+     * Leave <script> elements out of documents
+     *
+     * Readability.js removes them before it looks at the document, and
+     * the JSON-LD it would have read from them is captured regardless.
+     */
+    void setSkipScripts(bool skip);
+
+    /**
+     * True if the last build stopped early because of the budget
+     */
+    bool isTruncated() const;
+
+    /**
+     * The number of nodes built so far
+     */
+    int nodeCount() const;
+
 private:
     struct PrivData;
     std::unique_ptr<PrivData> d;
 
-    void visitElementOpen(GumboNode *node) override;
-    void visitText(GumboNode *node) override;
-    void visitElementClose(GumboNode *node) override;
+    friend class GumboVisitor<DomBuilder>;
+    void visitElementOpen(GumboNode *node);
+    void visitText(GumboNode *node);
+    void visitElementClose(GumboNode *node);
+    bool admitNode();
+    void captureMetadata(GumboNode *node);
 };
 }
@@ -3,77 +3,231 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include "domsupport.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QQmlEngine>
+#include <QRegularExpression>
 #include <gumbo/gumbo.h>
 #include <QPair>
-#include "dombuilder.h"
+#include "atoms.h"
+#include "classifier.h"
+#include "fragmentparser.h"
+#include "statscollector.h"
 using namespace QReadable;
 using namespace QReadable::DomSupport;
 
+DomSupport::Node::NodeType Node::nodeType()
+{
+    QREADABLE_NATIVE_CALL("Node.nodeType");
+    return QREADABLE_NATIVE_RESULT(UNKNOWN_NODE);
+}
+
+QString Node::nodeName()
+{
+    QREADABLE_NATIVE_CALL("Node.nodeName");
+    return QREADABLE_NATIVE_RESULT(QString());
+}
+
+QString Node::localName() const
+{
+    QREADABLE_NATIVE_CALL("Node.localName");
+    return QREADABLE_NATIVE_RESULT(m_localName);
+}
+
+Node::~Node()
+{
+    // ~QObject destroys children recursively, one stack frame per level,
+    // which deeply nested documents would overflow.  So a root deletes its
+    // descendants itself, leaves first, and ~QObject finds none left.
+    if (parent()) {
+        return;
+    }
+    QObject *node = this;
+    while (true) {
+        const QObjectList &children = node->children();
+        if (!children.isEmpty()) {
+            // the first child is the cheapest for its parent to unlink
+            node = children.first();
+        } else if (node == this) {
+            return;
+        } else {
+            QObject *parentObject = node->parent();
+            delete node;
+            node = parentObject;
+        }
+    }
+}
+
 void Node::clear()
 {
-    while (auto *last = lastChild()) {
-        removeChild(last);
+    // the children stay alive, owned by this node, in case script holds them
+    for (Node *eachChild : qAsConst(m_childNodes)) {
+        eachChild->m_parentNode = nullptr;
+        eachChild->m_previousSibling = eachChild->m_nextSibling = nullptr;
     }
+    for (Element *eachChild : qAsConst(m_children)) {
+        eachChild->m_previousElementSibling = eachChild->m_nextElementSibling = nullptr;
+    }
+    m_childNodes.clear();
+    m_children.clear();
+    childrenChanged();
+}
+
+// Document caches elements found near the top of the tree, which only
+// change when one of the top few levels gains or loses children
+static constexpr int kDocumentCacheDepth = 3;
+
+// Counts changes to the trees on this thread; what an element caches
+// about its subtree is valid while this is unchanged
+static thread_local quint64 treeVersion = 1;
+
+void Node::childrenChanged()
+{
+    treeVersion++;
+    Node *node = this;
+    for (int depth = 0; node && depth < kDocumentCacheDepth; depth++) {
+        if (!node->m_parentNode) {
+            if (auto *document = qobject_cast<Document *>(node)) {
+                document->structureChanged();
+            }
+            return;
+        }
+        node = node->m_parentNode;
+    }
+}
+
+void Node::serializeChildren(QStringList &fragments, bool textOnly)
+{
+    // walk the tree through the sibling and parent links, so that the
+    // only state is the current node
+    Node *node = m_childNodes.value(0, nullptr);
+    while (node) {
+        if (node->nodeType() == ELEMENT_NODE) {
+            auto *element = static_cast<Element *>(node);
+            if (!textOnly) {
+                element->serializeStartTag(fragments);
+            }
+            if (Node *firstChild = element->m_childNodes.value(0, nullptr)) {
+                node = firstChild;
+                continue;
+            }
+        } else {
+            node->serialize(fragments, textOnly);
+        }
+
+        while (!node->m_nextSibling) {
+            node = node->m_parentNode;
+            if (!node || node == this) {
+                return;
+            }
+            if (!textOnly) {
+                fragments << "</" << node->m_localName << ">";
+            }
+        }
+        node = node->m_nextSibling;
+    }
+}
+
+QList<Attribute *> Node::attributes() const
+{
+    QREADABLE_NATIVE_CALL("Node.attributes");
+    return QREADABLE_NATIVE_RESULT(m_attributes);
+}
+
+QList<DomSupport::Node *> Node::childNodes() const
+{
+    QREADABLE_NATIVE_CALL("Node.childNodes");
+    return QREADABLE_NATIVE_RESULT(m_childNodes);
+}
+
+QList<Element *> Node::elementChildren() const
+{
+    QREADABLE_NATIVE_CALL("Node.children");
+    return QREADABLE_NATIVE_RESULT(m_children);
+}
+
+DomSupport::Node *Node::parentNode() const
+{
+    QREADABLE_NATIVE_CALL("Node.parentNode");
+    return QREADABLE_NATIVE_RESULT(m_parentNode);
+}
+
+DomSupport::Node *Node::previousSibling() const
+{
+    QREADABLE_NATIVE_CALL("Node.previousSibling");
+    return QREADABLE_NATIVE_RESULT(m_previousSibling);
+}
+
+DomSupport::Node *Node::nextSibling() const
+{
+    QREADABLE_NATIVE_CALL("Node.nextSibling");
+    return QREADABLE_NATIVE_RESULT(m_nextSibling);
 }
 
 DomSupport::Node *DomSupport::Node::firstChild() const
 {
-    return m_childNodes.value(0, nullptr);
+    QREADABLE_NATIVE_CALL("Node.firstChild");
+    return QREADABLE_NATIVE_RESULT(m_childNodes.value(0, nullptr));
 }
 
 DomSupport::Element *DomSupport::Node::firstElementChild() const
 {
-    return m_children.value(0, nullptr);
+    QREADABLE_NATIVE_CALL("Node.firstElementChild");
+    return QREADABLE_NATIVE_RESULT(m_children.value(0, nullptr));
 }
 
 DomSupport::Node *DomSupport::Node::lastChild() const
 {
+    QREADABLE_NATIVE_CALL("Node.lastChild");
     if (m_childNodes.isEmpty()) {
-        return nullptr;
+        return QREADABLE_NATIVE_RESULT(nullptr);
     }
-    return m_childNodes.last();
+    return QREADABLE_NATIVE_RESULT(m_childNodes.last());
 }
 
 DomSupport::Element *DomSupport::Node::lastElementChild() const
 {
+    QREADABLE_NATIVE_CALL("Node.lastElementChild");
     if (m_children.isEmpty()) {
-        return nullptr;
+        return QREADABLE_NATIVE_RESULT(nullptr);
     }
-    return m_children.last();
+    return QREADABLE_NATIVE_RESULT(m_children.last());
 }
 
 Document *Node::ownerDocument() const
 {
+    QREADABLE_NATIVE_CALL("Node.ownerDocument");
     for(Node *eachAncestor=m_parentNode; eachAncestor; eachAncestor = eachAncestor->m_parentNode) {
         if (auto *doc = dynamic_cast<Document*>(eachAncestor)) {
-            return doc;
+            return QREADABLE_NATIVE_RESULT(doc);
         }
     }
-    return nullptr;
+    return QREADABLE_NATIVE_RESULT(nullptr);
 }
 
-static void walkNextElement(Element *&el) {
-    if (Element *fec = el->firstElementChild()) {
-        el = fec;
-    } else if (Element *nes = el->m_nextElementSibling) {
-        el = nes;
-    } else {
-        // find the first parent that has a next element
-        while (el) {
-            if (auto *parentElement = dynamic_cast<Element*>(el->m_parentNode)) {
-                if (Element *parentNext = parentElement->m_nextElementSibling) {
-                    el = parentNext;
-                    return;
-                }
-                el = parentElement;
-            } else {
-                el = nullptr;
-            }
+// Step to the element after el and its descendants, or null at the end of root
+static void walkPastElement(Element *&el, const Node *root) {
+    // find the first ancestor below root that has a next element
+    while (el) {
+        if (Element *next = el->m_nextElementSibling) {
+            el = next;
+            return;
         }
+        Node *parent = el->m_parentNode;
+        el = parent && parent != root ? static_cast<Element *>(parent) : nullptr;
     }
 }
 
+// Advance \a el to the next element in document order, or to null once it would leave \a root
+static void walkNextElement(Element *&el, const Node *root) {
+    if (!el->m_children.isEmpty()) {
+        el = el->m_children.first();
+        return;
+    }
+    walkPastElement(el, root);
+}
+
 QList<Element *> Node::getElementsByTagName(const QString &tag, int max_elems)
 {
     int n{0};
@@ -81,8 +235,7 @@ QList<Element *> Node::getElementsByTagName(const QString &tag, int max_elems)
         return {};
     }
     bool isGetAll = (tag=="*");
-    QString tagUpper = tag.toUpper();
-    GumboTag gumboTag = gumbo_tag_enum(tagUpper.toUtf8());
+    GumboTag gumboTag = Atoms::tagForName(tag);
     QList<Element*> result;
     Element *candidate = m_children.first();
     while (candidate) {
@@ -93,19 +246,21 @@ QList<Element *> Node::getElementsByTagName(const QString &tag, int max_elems)
                 break;
             }
         }
-        walkNextElement(candidate);
+        walkNextElement(candidate, this);
     }
     return result;
 }
 
 QList<Element *> Node::getElementsByTagName(const QString &tag)
 {
-    return getElementsByTagName(tag, INT_MAX);
+    QREADABLE_NATIVE_CALL("Node.getElementsByTagName", tag);
+    return QREADABLE_NATIVE_RESULT(getElementsByTagName(tag, INT_MAX));
 }
 
 
 void DomSupport::Node::appendChild(Node *child)
 {
+    QREADABLE_NATIVE_CALL("Node.appendChild", child);
     child->setParent(this);
     if (child->m_parentNode) {
         child->m_parentNode->removeChild(child);
@@ -124,11 +279,23 @@ void DomSupport::Node::appendChild(Node *child)
     }
     m_childNodes.push_back(child);
     child->m_parentNode = this;
+    childrenChanged();
+}
+
+// The index of \a item in \a list; children are mostly removed from one end or the other
+template<typename T>
+static int indexFromEnds(const QList<T *> &list, T *item)
+{
+    if (!list.isEmpty() && list.last() == item) {
+        return list.size() - 1;
+    }
+    return list.indexOf(item);
 }
 
 Node *Node::removeChild(Node *child)
 {
-    int childIndex = m_childNodes.indexOf(child);
+    StatsCollector::Call call("Node.removeChild", child);
+    int childIndex = indexFromEnds(m_childNodes, child);
     if (childIndex < 0) {
         return nullptr; // TODO should throw
     }
@@ -143,6 +310,9 @@ Node *Node::removeChild(Node *child)
     }
 
     if (auto childElement = dynamic_cast<Element*>(child)) {
+        if (StatsCollector *collector = call.outermost()) {
+            collector->m_elementsRemoved++;
+        }
         Element *prevElement = childElement->m_previousElementSibling;
         Element *nextElement = childElement->m_nextElementSibling;
         if (prevElement) {
@@ -152,11 +322,110 @@ Node *Node::removeChild(Node *child)
             nextElement->m_previousElementSibling = prevElement;
         }
         childElement->m_previousElementSibling = childElement->m_nextElementSibling = nullptr;
-        m_children.removeOne(childElement);
+        m_children.removeAt(indexFromEnds(m_children, childElement));
     }
     child->m_previousSibling = child->m_nextSibling = nullptr;
     m_childNodes.removeAt(childIndex);
-    return child;
+    childrenChanged();
+    return call.result(child);
+}
+
+// The index in \a list of a range of \a size items between \a before and \a after,
+// counted from whichever end of the list is nearer
+template<typename T>
+static int rangeIndex(const QList<T *> &list, int size, T *before, T *after, T *T::*previous, T *T::*next)
+{
+    int steps = 0;
+    while (before && after) {
+        before = before->*previous;
+        after = after->*next;
+        ++steps;
+    }
+    return before ? list.size() - size - steps : steps;
+}
+
+void Node::moveChildrenTo(Node *target, Node *first, Node *end)
+{
+    QREADABLE_NATIVE_CALL("Node.moveChildrenTo", target, first, end);
+    if (!first) {
+        first = firstChild();
+    }
+    if (!target || target == this || !first || first == end || first->m_parentNode != this) {
+        return;
+    }
+    // follow the sibling links rather than searching the child list
+    QList<Node *> moved;
+    QList<Element *> movedElements;
+    for (Node *eachNode = first; eachNode != end; eachNode = eachNode->m_nextSibling) {
+        if (!eachNode) {
+            // end isn't a later child
+            return;
+        }
+        moved.append(eachNode);
+        if (auto *eachElement = dynamic_cast<Element *>(eachNode)) {
+            movedElements.append(eachElement);
+        }
+    }
+    for (Node *ancestor = target; ancestor; ancestor = ancestor->m_parentNode) {
+        if (ancestor->m_parentNode == this) {
+            if (moved.contains(ancestor)) {
+                return;
+            }
+            break;
+        }
+    }
+    // Moving costs the nodes moved plus those on the nearer side of them, as
+    // erasing them from the lists does: cheap from either end of a long list,
+    // but not from the middle
+    int firstIndex = rangeIndex(m_childNodes, moved.size(), first->m_previousSibling, end,
+                                &Node::m_previousSibling, &Node::m_nextSibling);
+    int endIndex = firstIndex + moved.size();
+
+    // close the gap the moved nodes leave; their links to each other stay as they are
+    Node *before = moved.first()->m_previousSibling;
+    if (before) {
+        before->m_nextSibling = end;
+    }
+    if (end) {
+        end->m_previousSibling = before;
+    }
+    m_childNodes.erase(m_childNodes.begin() + firstIndex, m_childNodes.begin() + endIndex);
+    if (!movedElements.isEmpty()) {
+        Element *prevElement = movedElements.first()->m_previousElementSibling;
+        Element *nextElement = movedElements.last()->m_nextElementSibling;
+        if (prevElement) {
+            prevElement->m_nextElementSibling = nextElement;
+        }
+        if (nextElement) {
+            nextElement->m_previousElementSibling = prevElement;
+        }
+        int elementIndex = rangeIndex(m_children, movedElements.size(), prevElement, nextElement,
+                                      &Element::m_previousElementSibling, &Element::m_nextElementSibling);
+        m_children.erase(m_children.begin() + elementIndex, m_children.begin() + elementIndex + movedElements.size());
+    }
+
+    Node *last = target->m_childNodes.value(target->m_childNodes.size() - 1, nullptr);
+    if (last) {
+        last->m_nextSibling = moved.first();
+    }
+    moved.first()->m_previousSibling = last;
+    moved.last()->m_nextSibling = nullptr;
+    if (!movedElements.isEmpty()) {
+        Element *lastElement = target->m_children.value(target->m_children.size() - 1, nullptr);
+        if (lastElement) {
+            lastElement->m_nextElementSibling = movedElements.first();
+        }
+        movedElements.first()->m_previousElementSibling = lastElement;
+        movedElements.last()->m_nextElementSibling = nullptr;
+        target->m_children.append(movedElements);
+    }
+    for (Node *eachNode : qAsConst(moved)) {
+        eachNode->setParent(target);
+        eachNode->m_parentNode = target;
+    }
+    target->m_childNodes.append(moved);
+    childrenChanged();
+    target->childrenChanged();
 }
 
 static void updateElementLinks(Element *newElement, Element *oldElement)
@@ -211,6 +480,7 @@ static void updateElementLinks(Node */* newNode */, Element *oldElement) {
 
 Node *Node::replaceChild(Node *newNode, Node *oldNode)
 {
+    StatsCollector::Call call("Node.replaceChild", newNode, oldNode);
     int childIndex = m_childNodes.indexOf(oldNode);
     if (childIndex < 0) {
         return nullptr; // TODO should throw
@@ -254,10 +524,14 @@ Node *Node::replaceChild(Node *newNode, Node *oldNode)
     oldNode->m_previousSibling = nullptr;
     oldNode->m_nextSibling = nullptr;
     if (auto *oldElement = dynamic_cast<Element*>(oldNode)) {
+        if (StatsCollector *collector = call.outermost()) {
+            collector->m_elementsRemoved++;
+        }
         oldElement->m_previousElementSibling = nullptr;
         oldElement->m_nextElementSibling = nullptr;
     }
-    return oldNode;
+    childrenChanged();
+    return call.result(oldNode);
 }
 
 Attribute::Attribute(const QString &name, const QString &value)
@@ -265,6 +539,34 @@ Attribute::Attribute(const QString &name, const QString &value)
     ,m_value(value)
 {}
 
+DomSupport::Node::NodeType Attribute::nodeType()
+{
+    QREADABLE_NATIVE_CALL("Attribute.nodeType");
+    return QREADABLE_NATIVE_RESULT(ATTRIBUTE_NODE);
+}
+
+QString Attribute::name() const
+{
+    QREADABLE_NATIVE_CALL("Attribute.name");
+    return QREADABLE_NATIVE_RESULT(m_name);
+}
+
+QString Attribute::value() const
+{
+    QREADABLE_NATIVE_CALL("Attribute.value");
+    return QREADABLE_NATIVE_RESULT(m_value);
+}
+
+void Attribute::setValue(const QString &value)
+{
+    QREADABLE_NATIVE_CALL("Attribute.value=", value);
+    // the owning element caches what it derives from its attributes
+    if (auto *owner = qobject_cast<Element *>(parent())) {
+        owner->attributeChanged(m_name);
+    }
+    m_value = value;
+}
+
 void Attribute::serialize(QStringList &fragments, bool textOnly)
 {
     if (textOnly) {
@@ -275,50 +577,103 @@ void Attribute::serialize(QStringList &fragments, bool textOnly)
 
 QString Attribute::getEncodedValue() const
 {
-    return m_value.toHtmlEscaped();
+    QREADABLE_NATIVE_CALL("Attribute.getEncodedValue");
+    return QREADABLE_NATIVE_RESULT(m_value.toHtmlEscaped());
+}
+
+DomSupport::Node::NodeType Comment::nodeType()
+{
+    QREADABLE_NATIVE_CALL("Comment.nodeType");
+    return QREADABLE_NATIVE_RESULT(COMMENT_NODE);
+}
+
+QString Comment::nodeName()
+{
+    QREADABLE_NATIVE_CALL("Comment.nodeName");
+    return QREADABLE_NATIVE_RESULT(QStringLiteral("#comment"));
+}
+
+DomSupport::Node::NodeType Text::nodeType()
+{
+    QREADABLE_NATIVE_CALL("Text.nodeType");
+    return QREADABLE_NATIVE_RESULT(TEXT_NODE);
+}
+
+QString Text::nodeName()
+{
+    QREADABLE_NATIVE_CALL("Text.nodeName");
+    return QREADABLE_NATIVE_RESULT(QStringLiteral("#text"));
 }
 
 QString Text::innerHTML()
 {
+    QREADABLE_NATIVE_CALL("Text.innerHTML");
+    materializeHtml();
     if (m_html.isNull()) {
         m_html = m_text.toHtmlEscaped();
     }
-    return m_html;
+    return QREADABLE_NATIVE_RESULT(m_html);
 }
 
 void Text::setInnerHTML(const QString &html)
 {
+    QREADABLE_NATIVE_CALL("Text.innerHTML=", html);
     m_html = html;
+    m_sourceHtml.clear();
     m_text.clear();
 }
 
 QString Text::textContent()
 {
+    QREADABLE_NATIVE_CALL("Text.textContent");
     if (m_text.isNull()) {
+        materializeHtml();
         if (m_html.isEmpty()) {
             m_text = "";
         } else {
-            QScopedPointer<Element> body(new Element("body"));
-            DomBuilder builder(m_html, GUMBO_TAG_BODY);
-            builder.buildIntoNode(body.data());
-            m_text = body->textContent();
+            m_text = FragmentParser::forCurrentThread().textContent(m_html);
         }
     }
-    return m_text;
+    return QREADABLE_NATIVE_RESULT(m_text);
 }
 
 void Text::setTextContent(const QString &text)
 {
+    QREADABLE_NATIVE_CALL("Text.textContent=", text);
     m_text = text;
     m_html.clear();
+    m_sourceHtml.clear();
 }
 
 void Text::appendTextContent(const QString &text, const QString &html)
 {
+    materializeHtml();
     m_text += text;
     m_html += html;
 }
 
+void Text::appendTextSource(const QString &text, const char *source, int length)
+{
+    m_text += text;
+    if (m_html.isNull() && m_sourceHtml.isNull()) {
+        m_sourceHtml = QByteArray::fromRawData(source, length);
+    } else if (m_html.isNull() && m_sourceHtml.constData() + m_sourceHtml.length() == source) {
+        // adjacent runs of text are usually adjacent in the source too
+        m_sourceHtml = QByteArray::fromRawData(m_sourceHtml.constData(), m_sourceHtml.length() + length);
+    } else {
+        materializeHtml();
+        m_html += QString::fromUtf8(source, length);
+    }
+}
+
+void Text::materializeHtml()
+{
+    if (!m_sourceHtml.isNull()) {
+        m_html = QString::fromUtf8(m_sourceHtml) + m_html;
+        m_sourceHtml.clear();
+    }
+}
+
 void Text::serialize(QStringList &fragments, bool textOnly)
 {
     if (textOnly) {
@@ -333,82 +688,362 @@ Document::Document(const QString& url)
     , m_baseURI(url)
 {}
 
+DomSupport::Node::NodeType Document::nodeType()
+{
+    QREADABLE_NATIVE_CALL("Document.nodeType");
+    return QREADABLE_NATIVE_RESULT(DOCUMENT_NODE);
+}
+
+QString Document::nodeName()
+{
+    QREADABLE_NATIVE_CALL("Document.nodeName");
+    return QREADABLE_NATIVE_RESULT(QStringLiteral("#document"));
+}
+
+QString Document::documentURI() const
+{
+    QREADABLE_NATIVE_CALL("Document.documentURI");
+    return QREADABLE_NATIVE_RESULT(m_url);
+}
+
+QUrl Document::baseURI() const
+{
+    QREADABLE_NATIVE_CALL("Document.baseURI");
+    return QREADABLE_NATIVE_RESULT(m_baseURI);
+}
+
 void Document::serialize(QStringList &fragments, bool textOnly)
 {
-    for(auto *eachChild : qAsConst(m_childNodes)) {
-        eachChild->serialize(fragments, textOnly);
-    }
+    serializeChildren(fragments, textOnly);
 }
 
 Element *Document::documentElement()
 {
-    return m_children.length() > 0 ? m_children.first() : nullptr;
+    QREADABLE_NATIVE_CALL("Document.documentElement");
+    return QREADABLE_NATIVE_RESULT(m_children.length() > 0 ? m_children.first() : nullptr);
 }
 
 QString Document::title()
 {
-    QList<Element*> match = getElementsByTagName("title", 1);
-    if (match.isEmpty()){
-        return QString();
+    QREADABLE_NATIVE_CALL("Document.title");
+    Element *title = structuralElement(m_titleElement, QStringLiteral("title"), 2);
+    if (!title) {
+        return QREADABLE_NATIVE_RESULT(QString());
     }
-    return match.first()->textContent();
+    return QREADABLE_NATIVE_RESULT(title->textContent());
 }
 
 Element *Document::body()
 {
-    QList<Element*> match = getElementsByTagName("body");
-    if (match.isEmpty()) {
-        return nullptr;
-    }
-    return match.first();
+    QREADABLE_NATIVE_CALL("Document.body");
+    return QREADABLE_NATIVE_RESULT(structuralElement(m_body, QStringLiteral("body"), 1));
 }
 
 Element *Document::head()
 {
-    QList<Element*> match = getElementsByTagName("head");
+    QREADABLE_NATIVE_CALL("Document.head");
+    return QREADABLE_NATIVE_RESULT(structuralElement(m_head, QStringLiteral("head"), 1));
+}
+
+Element *Document::structuralElement(Element *&cache, const QString &tag, int depth)
+{
+    if (cache) {
+        return cache;
+    }
+    QList<Element*> match = getElementsByTagName(tag, 1);
     if (match.isEmpty()) {
         return nullptr;
     }
+    Node *ancestor = match.first();
+    for (int i = 0; i < depth && ancestor; i++) {
+        ancestor = ancestor->m_parentNode;
+    }
+    if (ancestor && ancestor == m_children.value(0, nullptr)) {
+        cache = match.first();
+    }
     return match.first();
 }
 
+void Document::structureChanged()
+{
+    m_head = m_body = m_titleElement = nullptr;
+}
+
+static Attribute *findAttribute(const Element *element, QLatin1String name)
+{
+    for (Attribute *attr : element->m_attributes) {
+        if (attr->m_name == name) {
+            return attr;
+        }
+    }
+    return nullptr;
+}
+
+static bool isSpecialScheme(const QString &scheme)
+{
+    return scheme == QLatin1String("http") || scheme == QLatin1String("https")
+            || scheme == QLatin1String("ftp") || scheme == QLatin1String("file");
+}
+
+// As Readability.js's toAbsoluteURI(): unresolvable URIs are left as they are
+static QString resolveUri(const QUrl &base, const QString &uri, bool keepFragmentLinks)
+{
+    if (keepFragmentLinks && uri.startsWith(QLatin1Char('#'))) {
+        return uri;
+    }
+    QUrl url(uri.trimmed());
+    if (!url.isValid() || (!url.isRelative() && !isSpecialScheme(url.scheme()))) {
+        return uri;
+    }
+    QUrl resolved = base.resolved(url);
+    if (!resolved.isValid() || resolved.isRelative()) {
+        return uri;
+    }
+    if (resolved.path().isEmpty() && !resolved.host().isEmpty()) {
+        resolved.setPath(QStringLiteral("/"));
+    }
+    return resolved.toString(QUrl::FullyEncoded);
+}
+
+// Resolve each URL in a srcset list, as Readability.js does with REGEXPS.srcsetUrl
+static QString resolveSrcset(const QUrl &base, const QString &srcset, bool keepFragmentLinks)
+{
+    static const QRegularExpression candidate(QStringLiteral("(\\S+)(\\s+[0-9.]+[xw])?(\\s*(?:,|\\z))"),
+                                              QRegularExpression::UseUnicodePropertiesOption);
+    QString result;
+    int last = 0;
+    QRegularExpressionMatchIterator matches = candidate.globalMatch(srcset);
+    while (matches.hasNext()) {
+        QRegularExpressionMatch match = matches.next();
+        result += srcset.midRef(last, match.capturedStart() - last);
+        result += resolveUri(base, match.captured(1), keepFragmentLinks);
+        result += match.capturedRef(2);
+        result += match.capturedRef(3);
+        last = match.capturedEnd();
+    }
+    result += srcset.midRef(last);
+    return result;
+}
+
+QList<Element *> Document::resolveRelativeUris(Element *root)
+{
+    QREADABLE_NATIVE_CALL("Document.resolveRelativeUris", root);
+    QList<Element *> scriptLinks;
+    if (!root || root->m_children.isEmpty()) {
+        return QREADABLE_NATIVE_RESULT(scriptLinks);
+    }
+    const bool keepFragmentLinks = m_baseURI == QUrl(m_url);
+    Element *element = root->m_children.first();
+    while (element) {
+        switch (element->gumboTag()) {
+        case GUMBO_TAG_A:
+            if (Attribute *href = findAttribute(element, QLatin1String("href"))) {
+                if (href->m_value.startsWith(QLatin1String("javascript:"))) {
+                    scriptLinks.append(element);
+                } else if (!href->m_value.isEmpty()) {
+                    href->m_value = resolveUri(m_baseURI, href->m_value, keepFragmentLinks);
+                }
+            }
+            break;
+        case GUMBO_TAG_IMG:
+        case GUMBO_TAG_PICTURE:
+        case GUMBO_TAG_FIGURE:
+        case GUMBO_TAG_VIDEO:
+        case GUMBO_TAG_AUDIO:
+        case GUMBO_TAG_SOURCE:
+            for (QLatin1String name : {QLatin1String("src"), QLatin1String("poster")}) {
+                Attribute *attr = findAttribute(element, name);
+                if (attr && !attr->m_value.isEmpty()) {
+                    attr->m_value = resolveUri(m_baseURI, attr->m_value, keepFragmentLinks);
+                }
+            }
+            if (Attribute *srcset = findAttribute(element, QLatin1String("srcset"))) {
+                if (!srcset->m_value.isEmpty()) {
+                    srcset->m_value = resolveSrcset(m_baseURI, srcset->m_value, keepFragmentLinks);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+        walkNextElement(element, root);
+    }
+    return QREADABLE_NATIVE_RESULT(scriptLinks);
+}
+
+bool Document::metadataCaptured() const
+{
+    QREADABLE_NATIVE_CALL("Document.metadataCaptured");
+    return QREADABLE_NATIVE_RESULT(m_metadataCaptured);
+}
+
+QVariant Document::metaValues() const
+{
+    QREADABLE_NATIVE_CALL("Document.metaValues");
+    return QREADABLE_NATIVE_RESULT(QVariant(m_metaValues));
+}
+
+void Document::addMetaTag(const QString &name, const QString &property, const QString &content)
+{
+    // property is a space-separated list of values, name a single value
+    static const QRegularExpression propertyPattern(
+                QStringLiteral("\\s*(dc|dcterm|og|twitter)\\s*:\\s*(author|creator|description|title|site_name)\\s*"),
+                QRegularExpression::CaseInsensitiveOption | QRegularExpression::UseUnicodePropertiesOption);
+    static const QRegularExpression namePattern(
+                QStringLiteral("^\\s*(?:(dc|dcterm|og|twitter|weibo:(article|webpage))\\s*[\\.:]\\s*)?(author|creator|description|title|site_name)\\s*\\z"),
+                QRegularExpression::CaseInsensitiveOption | QRegularExpression::UseUnicodePropertiesOption);
+    static const QRegularExpression whitespace(QStringLiteral("\\s"), QRegularExpression::UseUnicodePropertiesOption);
+    if (content.isEmpty()) {
+        return;
+    }
+    if (!property.isEmpty()) {
+        QRegularExpressionMatch match = propertyPattern.match(property);
+        if (match.hasMatch()) {
+            m_metaValues.insert(match.captured(0).toLower().remove(whitespace), content.trimmed());
+            return;
+        }
+    }
+    if (!name.isEmpty() && namePattern.match(name).hasMatch()) {
+        m_metaValues.insert(name.toLower().remove(whitespace).replace(QLatin1Char('.'), QLatin1Char(':')), content.trimmed());
+    }
+}
+
+// Whether script would treat value as true
+static bool isTruthy(const QJsonValue &value)
+{
+    switch (value.type()) {
+    case QJsonValue::Bool:
+        return value.toBool();
+    case QJsonValue::Double:
+        return value.toDouble() != 0 && !qIsNaN(value.toDouble());
+    case QJsonValue::String:
+        return !value.toString().isEmpty();
+    case QJsonValue::Array:
+    case QJsonValue::Object:
+        return true;
+    default:
+        return false;
+    }
+}
+
+QVariant Document::jsonLd() const
+{
+    QREADABLE_NATIVE_CALL("Document.jsonLd");
+    static const QRegularExpression cdata(QStringLiteral("^\\s*<!\\[CDATA\\[|\\]\\]>\\s*\\z"),
+                                          QRegularExpression::UseUnicodePropertiesOption);
+    static const QRegularExpression schemaOrg(QStringLiteral("^https?\\:\\/\\/schema\\.org\\z"));
+    static const QRegularExpression articleTypes(QStringLiteral(
+        "^Article|AdvertiserContentArticle|NewsArticle|AnalysisNewsArticle|AskPublicNewsArticle|"
+        "BackgroundNewsArticle|OpinionNewsArticle|ReportageNewsArticle|ReviewNewsArticle|Report|"
+        "SatiricalArticle|ScholarlyArticle|MedicalScholarlyArticle|SocialMediaPosting|BlogPosting|"
+        "LiveBlogPosting|DiscussionForumPosting|TechArticle|APIReference\\z"));
+
+    // where Readability.js would throw, and so give up on the script, this skips it
+    for (QString content : m_jsonLdScripts) {
+        QJsonDocument json = QJsonDocument::fromJson(content.remove(cdata).toUtf8());
+        if (!json.isObject()) {
+            continue;
+        }
+        QJsonObject parsed = json.object();
+        QJsonValue context = parsed.value(QLatin1String("@context"));
+        if (!isTruthy(context) || !context.isString() || !schemaOrg.match(context.toString()).hasMatch()) {
+            continue;
+        }
+        QJsonValue graph = parsed.value(QLatin1String("@graph"));
+        if (!isTruthy(parsed.value(QLatin1String("@type"))) && graph.isArray()) {
+            bool found = false;
+            for (const QJsonValue &item : graph.toArray()) {
+                if (item.isNull()) {
+                    break;
+                }
+                QJsonValue type = item.toObject().value(QLatin1String("@type"));
+                if (isTruthy(type) && !type.isString()) {
+                    break;
+                }
+                if (articleTypes.match(type.toString()).hasMatch()) {
+                    parsed = item.toObject();
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                continue;
+            }
+        }
+        QJsonValue type = parsed.value(QLatin1String("@type"));
+        if (isTruthy(type) && type.isString() && articleTypes.match(type.toString()).hasMatch()) {
+            return QREADABLE_NATIVE_RESULT(QVariant(parsed.toVariantMap()));
+        }
+    }
+    return QREADABLE_NATIVE_RESULT(QVariant());
+}
+
 Element *Document::getElementById(const QString &id)
 {
+    QREADABLE_NATIVE_CALL("Document.getElementById", id);
     if (m_children.isEmpty()) {
         return {};
     }
     Element *candidate = m_children.first();
     while (candidate) {
         if (candidate->id() == id) {
-            return candidate;
+            return QREADABLE_NATIVE_RESULT(candidate);
         }
-        walkNextElement(candidate);
+        walkNextElement(candidate, this);
     }
-    return nullptr;
+    return QREADABLE_NATIVE_RESULT(nullptr);
 }
 
 Element *Document::createElement(const QString &tag)
 {
-    return new Element(tag);
+    QREADABLE_NATIVE_CALL("Document.createElement", tag);
+    return QREADABLE_NATIVE_RESULT(new Element(tag));
 }
 
 Text *Document::createTextNode(const QString &text)
 {
+    QREADABLE_NATIVE_CALL("Document.createTextNode", text);
     auto result = new Text();
     result->setTextContent(text);
-    return result;
+    return QREADABLE_NATIVE_RESULT(result);
 }
 
 
+struct Element::TableShape {
+    quint64 treeVersion{0};
+    double rows{0};
+    double columns{0};
+    bool hasCaption{false};
+    bool hasDataDescendant{false};
+    bool hasNestedTable{false};
+};
+
 Element::Element(const QString &tag)
-    : m_tagName(tag.toUpper())
-    , m_style(new Style(this))
-{}
+    : m_style(new Style(this))
+{
+    setTag(tag);
+}
 
 Element::Element(int gumboTag)
-    : Element(gumbo_normalized_tagname(static_cast<GumboTag>(gumboTag)))
+    : m_tagName(Atoms::upperTagName(static_cast<GumboTag>(gumboTag)))
+    , m_gumboTag(gumboTag)
+    , m_style(new Style(this))
+{
+    m_localName = Atoms::lowerTagName(static_cast<GumboTag>(gumboTag));
+}
+
+Element::~Element() = default;
+
+DomSupport::Node::NodeType Element::nodeType()
 {
-    m_gumboTag = gumboTag;
+    QREADABLE_NATIVE_CALL("Element.nodeType");
+    return QREADABLE_NATIVE_RESULT(ELEMENT_NODE);
+}
+
+QString Element::nodeName()
+{
+    QREADABLE_NATIVE_CALL("Element.nodeName");
+    return QREADABLE_NATIVE_RESULT(m_tagName);
 }
 
 void Element::serialize(QStringList &fragments, bool textOnly)
@@ -417,46 +1052,49 @@ void Element::serialize(QStringList &fragments, bool textOnly)
         serializeChildren(fragments, true);
         return;
     }
-    QString name = localName();
-    fragments << "<" << name;
-    for(auto *eachAttr : qAsConst(m_attributes)) {
-        eachAttr->serialize(fragments);
+    serializeStartTag(fragments);
+    if (!m_childNodes.isEmpty()) {
+        serializeChildren(fragments, false);
+        fragments << "</" << m_localName << ">";
     }
+}
 
-    if (m_childNodes.isEmpty()) {
-        fragments << "/>";
-    } else {
-        fragments << ">";
-        serializeChildren(fragments, textOnly);
-        fragments << "</" << name << ">";
+// Elements without children are written as self-closing tags
+void Element::serializeStartTag(QStringList &fragments)
+{
+    fragments << "<" << m_localName;
+    for(auto *eachAttr : qAsConst(m_attributes)) {
+        eachAttr->serialize(fragments);
     }
+    fragments << (m_childNodes.isEmpty() ? "/>" : ">");
 }
 
 QString Element::innerHTML()
 {
+    QREADABLE_NATIVE_CALL("Element.innerHTML");
     QStringList fragments;
     serializeChildren(fragments, false);
-    return fragments.join("");
+    return QREADABLE_NATIVE_RESULT(fragments.join(""));
 }
 
 void Element::setInnerHTML(const QString &html)
 {
+    QREADABLE_NATIVE_CALL("Element.innerHTML=", html);
    clear();
-   if (!html.isEmpty()) {
-       DomBuilder builder(html, static_cast<GumboTag>(gumboTag()));
-       builder.buildIntoNode(this);
-   }
+   FragmentParser::forCurrentThread().parseInto(this, html, static_cast<GumboTag>(gumboTag()));
 }
 
 QString Element::textContent()
 {
+    QREADABLE_NATIVE_CALL("Element.textContent");
     QStringList fragments;
     serializeChildren(fragments, true);
-    return fragments.join("");
+    return QREADABLE_NATIVE_RESULT(fragments.join(""));
 }
 
 void Element::setTextContent(const QString &text)
 {
+    QREADABLE_NATIVE_CALL("Element.textContent=", text);
     clear();
     Text *textNode = new Text();
     textNode->setTextContent(text);
@@ -465,84 +1103,352 @@ void Element::setTextContent(const QString &text)
 
 QString Element::className() const
 {
-    return getAttribute("class");
+    QREADABLE_NATIVE_CALL("Element.className");
+    return QREADABLE_NATIVE_RESULT(getAttribute("class"));
 }
 
 void Element::setClassName(const QString &newClassName)
 {
+    QREADABLE_NATIVE_CALL("Element.className=", newClassName);
     setAttribute("class", newClassName);
 }
 
 QString Element::id() const
 {
-    return getAttribute("id");
+    QREADABLE_NATIVE_CALL("Element.id");
+    return QREADABLE_NATIVE_RESULT(getAttribute("id"));
 }
 
 void Element::setId(const QString &newId)
 {
+    QREADABLE_NATIVE_CALL("Element.id=", newId);
     setAttribute("id", newId);
 }
 
 QString Element::href() const
 {
-    return getAttribute("href");
+    QREADABLE_NATIVE_CALL("Element.href");
+    return QREADABLE_NATIVE_RESULT(getAttribute("href"));
 }
 
 void Element::setHref(const QString &newHref)
 {
+    QREADABLE_NATIVE_CALL("Element.href=", newHref);
     setAttribute("href", newHref);
 }
 
 QString Element::src() const
 {
-    return getAttribute("src");
+    QREADABLE_NATIVE_CALL("Element.src");
+    return QREADABLE_NATIVE_RESULT(getAttribute("src"));
 }
 
 void Element::setSrc(const QString &newSrc)
 {
+    QREADABLE_NATIVE_CALL("Element.src=", newSrc);
     setAttribute("src", newSrc);
 }
 
 QString Element::srcset() const
 {
-    return getAttribute("srcset");
+    QREADABLE_NATIVE_CALL("Element.srcset");
+    return QREADABLE_NATIVE_RESULT(getAttribute("srcset"));
 }
 
 void Element::setSrcset(const QString &newSrcset)
 {
+    QREADABLE_NATIVE_CALL("Element.srcset=", newSrcset);
     setAttribute("srcset", newSrcset);
 }
 
 QString Element::tagName() const
 {
-    return m_tagName;
+    QREADABLE_NATIVE_CALL("Element.tagName");
+    return QREADABLE_NATIVE_RESULT(m_tagName);
+}
+
+QString Element::localName() const
+{
+    QREADABLE_NATIVE_CALL("Element.localName");
+    return QREADABLE_NATIVE_RESULT(m_localName);
+}
+
+Element *Element::previousElementSibling() const
+{
+    QREADABLE_NATIVE_CALL("Element.previousElementSibling");
+    return QREADABLE_NATIVE_RESULT(m_previousElementSibling);
 }
 
-QString Element::localName()
+Element *Element::nextElementSibling() const
 {
-    return m_tagName.toLower();
+    QREADABLE_NATIVE_CALL("Element.nextElementSibling");
+    return QREADABLE_NATIVE_RESULT(m_nextElementSibling);
 }
 
 int Element::gumboTag() const
 {
-    if (m_gumboTag < 0) {
-        m_gumboTag = gumbo_tag_enum(m_tagName.toUtf8());
-    }
     return m_gumboTag;
 }
 
+void Element::setTag(const QString &tag)
+{
+    treeVersion++;
+    m_gumboTag = Atoms::tagForName(tag);
+    if (m_gumboTag != GUMBO_TAG_UNKNOWN) {
+        m_tagName = Atoms::upperTagName(static_cast<GumboTag>(m_gumboTag));
+        m_localName = Atoms::lowerTagName(static_cast<GumboTag>(m_gumboTag));
+    } else {
+        m_tagName = tag.toUpper();
+        m_localName = tag.toLower();
+    }
+}
+
+Element *Element::renameTag(const QString &tag)
+{
+    QREADABLE_NATIVE_CALL("Element.renameTag", tag);
+    setTag(tag);
+    if (m_parentNode) {
+        // as far as Document is concerned, the parent has a new child
+        m_parentNode->childrenChanged();
+    }
+    return QREADABLE_NATIVE_RESULT(this);
+}
+
+int Element::classifierFlags() const
+{
+    QREADABLE_NATIVE_CALL("Element.classifierFlags");
+    if (m_classifierFlags < 0) {
+        m_classifierFlags = Classifier::classify(className(), id());
+    }
+    return QREADABLE_NATIVE_RESULT(m_classifierFlags);
+}
+
+// parseInt(value, 10) || 1, as _getRowAndColumnCount() reads spans
+static double spanValue(const Attribute *attr)
+{
+    if (!attr) {
+        return 1;
+    }
+    const QString &value = attr->m_value;
+    int i = 0;
+    while (i < value.size() && (value.at(i).isSpace() || value.at(i) == QChar(0xfeff))) {
+        i++;
+    }
+    double sign = 1;
+    if (i < value.size() && (value.at(i) == QLatin1Char('-') || value.at(i) == QLatin1Char('+'))) {
+        sign = value.at(i) == QLatin1Char('-') ? -1 : 1;
+        i++;
+    }
+    double span = 0;
+    for (; i < value.size() && value.at(i) >= QLatin1Char('0') && value.at(i) <= QLatin1Char('9'); i++) {
+        span = span * 10 + value.at(i).digitValue();
+    }
+    return span != 0 ? sign * span : 1;
+}
+
+const Element::TableShape &Element::measureTable() const
+{
+    if (!m_tableShape) {
+        m_tableShape = std::make_unique<TableShape>();
+    }
+    TableShape &shape = *m_tableShape;
+    if (shape.treeVersion == treeVersion) {
+        return shape;
+    }
+    shape = TableShape();
+    shape.treeVersion = treeVersion;
+    bool foundCaption = false;
+    // the cells of a row are counted until a cell in another row turns up
+    Element *row = nullptr;
+    double columnsInRow = 0;
+    Element *element = m_children.value(0, nullptr);
+    while (element) {
+        switch (element->m_gumboTag) {
+        case GUMBO_TAG_CAPTION:
+            if (!foundCaption) {
+                foundCaption = true;
+                shape.hasCaption = !element->m_childNodes.isEmpty();
+            }
+            break;
+        case GUMBO_TAG_COL:
+        case GUMBO_TAG_COLGROUP:
+        case GUMBO_TAG_TFOOT:
+        case GUMBO_TAG_THEAD:
+        case GUMBO_TAG_TH:
+            shape.hasDataDescendant = true;
+            break;
+        case GUMBO_TAG_TABLE:
+            shape.hasNestedTable = true;
+            break;
+        case GUMBO_TAG_TR:
+            shape.rows += spanValue(findAttribute(element, QLatin1String("rowspan")));
+            break;
+        case GUMBO_TAG_TD: {
+            Node *ancestor = element->m_parentNode;
+            Element *cellRow = nullptr;
+            for (; ancestor && ancestor != this && !cellRow; ancestor = ancestor->m_parentNode) {
+                auto *ancestorElement = dynamic_cast<Element *>(ancestor);
+                if (ancestorElement && ancestorElement->m_gumboTag == GUMBO_TAG_TR) {
+                    cellRow = ancestorElement;
+                }
+            }
+            if (!cellRow) {
+                break;
+            }
+            if (cellRow != row) {
+                shape.columns = qMax(shape.columns, columnsInRow);
+                row = cellRow;
+                columnsInRow = 0;
+            }
+            columnsInRow += spanValue(findAttribute(element, QLatin1String("colspan")));
+            break;
+        }
+        default:
+            break;
+        }
+        walkNextElement(element, this);
+    }
+    shape.columns = qMax(shape.columns, columnsInRow);
+    return shape;
+}
+
+QVariantMap Element::tableShape() const
+{
+    QREADABLE_NATIVE_CALL("Element.tableShape");
+    const TableShape &shape = measureTable();
+    return QREADABLE_NATIVE_RESULT((QVariantMap{
+        {QStringLiteral("rows"), shape.rows},
+        {QStringLiteral("columns"), shape.columns},
+        {QStringLiteral("caption"), shape.hasCaption},
+        {QStringLiteral("dataDescendants"), shape.hasDataDescendant},
+        {QStringLiteral("nestedTables"), shape.hasNestedTable}}));
+}
+
+bool Element::isDataTable() const
+{
+    QREADABLE_NATIVE_CALL("Element.dataTable");
+    const Attribute *role = findAttribute(this, QLatin1String("role"));
+    const Attribute *datatable = findAttribute(this, QLatin1String("datatable"));
+    if ((role && role->m_value == QLatin1String("presentation"))
+            || (datatable && datatable->m_value == QLatin1String("0"))) {
+        return QREADABLE_NATIVE_RESULT(false);
+    }
+    const Attribute *summary = findAttribute(this, QLatin1String("summary"));
+    if (summary && !summary->m_value.isEmpty()) {
+        return QREADABLE_NATIVE_RESULT(true);
+    }
+    const TableShape &shape = measureTable();
+    if (shape.hasCaption || shape.hasDataDescendant) {
+        return QREADABLE_NATIVE_RESULT(true);
+    }
+    if (shape.hasNestedTable) {
+        return QREADABLE_NATIVE_RESULT(false);
+    }
+    return QREADABLE_NATIVE_RESULT(shape.rows >= 10 || shape.columns > 4 || shape.rows * shape.columns > 10);
+}
+
+static QSet<QString> stringSet(const QStringList &list)
+{
+    QSet<QString> result;
+    result.reserve(list.size());
+    for (const QString &each : list) {
+        result.insert(each);
+    }
+    return result;
+}
+
+void Element::cleanClasses(const QStringList &classesToPreserve)
+{
+    QREADABLE_NATIVE_CALL("Element.cleanClasses", classesToPreserve);
+    static const QRegularExpression whitespace(QStringLiteral("\\s+"), QRegularExpression::UseUnicodePropertiesOption);
+    const QSet<QString> preserved = stringSet(classesToPreserve);
+    Element *element = this;
+    while (element) {
+        Attribute *classAttr = findAttribute(element, QLatin1String("class"));
+        QStringList kept;
+        const QStringList classes = classAttr ? classAttr->m_value.split(whitespace) : QStringList{QString()};
+        for (const QString &eachClass : classes) {
+            if (preserved.contains(eachClass)) {
+                kept.append(eachClass);
+            }
+        }
+        QString className = kept.join(QLatin1Char(' '));
+        if (className.isEmpty()) {
+            if (classAttr) {
+                element->removeAttributes({classAttr->m_name});
+            }
+        } else if (classAttr->m_value != className) {
+            element->attributeChanged(classAttr->m_name);
+            classAttr->m_value = className;
+        }
+        if (element == this) {
+            element = m_children.value(0, nullptr);
+        } else {
+            walkNextElement(element, this);
+        }
+    }
+}
+
+void Element::cleanStyles(const QStringList &attributes, const QStringList &sizeAttributeTags)
+{
+    QREADABLE_NATIVE_CALL("Element.cleanStyles", attributes, sizeAttributeTags);
+    const QSet<QString> names = stringSet(attributes);
+    QSet<QString> namesWithSize = names;
+    namesWithSize << QStringLiteral("width") << QStringLiteral("height");
+    const QSet<QString> sizeTags = stringSet(sizeAttributeTags);
+    Element *element = this;
+    while (element) {
+        if (element->m_gumboTag == GUMBO_TAG_SVG) {
+            if (element == this) {
+                break;
+            }
+            walkPastElement(element, this);
+            continue;
+        }
+        element->removeAttributes(sizeTags.contains(element->m_tagName) ? namesWithSize : names);
+        if (element == this) {
+            element = m_children.value(0, nullptr);
+        } else {
+            walkNextElement(element, this);
+        }
+    }
+}
+
+void Element::removeAttributes(const QSet<QString> &names)
+{
+    for (int i = 0; i < m_attributes.size();) {
+        if (names.contains(m_attributes.at(i)->m_name)) {
+            attributeChanged(m_attributes.at(i)->m_name);
+            m_attributes.removeAt(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void Element::attributeChanged(const QString &name)
+{
+    treeVersion++;
+    if (name == QLatin1String("class") || name == QLatin1String("id")) {
+        m_classifierFlags = -1;
+    }
+}
+
 QString Element::getAttribute(const QString &name) const
 {
+    QREADABLE_NATIVE_CALL("Element.getAttribute", name);
     for (Attribute *eachAttr : qAsConst(m_attributes)) {
         if (eachAttr->m_name == name) {
-            return eachAttr->m_value;
+            return QREADABLE_NATIVE_RESULT(eachAttr->m_value);
         }
     }
-    return QString();
+    return QREADABLE_NATIVE_RESULT(QString());
 }
 
 void Element::setAttribute(const QString &name, const QString &value)
 {
+    QREADABLE_NATIVE_CALL("Element.setAttribute", name, value);
+    attributeChanged(name);
     for (Attribute *eachAttr : qAsConst(m_attributes)) {
         if (eachAttr->m_name == name) {
             eachAttr->m_value = value;
@@ -556,29 +1462,25 @@ void Element::setAttribute(const QString &name, const QString &value)
 
 void Element::removeAttribute(const QString &name)
 {
+    QREADABLE_NATIVE_CALL("Element.removeAttribute", name);
     auto it = std::find_if(m_attributes.begin(), m_attributes.end(), [&name](Attribute *&attr){
         return name==attr->m_name;
     });
     if (it==m_attributes.end()) {
         return;
     }
+    attributeChanged(name);
     m_attributes.erase(it);
 }
 
 bool Element::hasAttribute(const QString &name)
 {
+    QREADABLE_NATIVE_CALL("Element.hasAttribute", name);
     return std::find_if(m_attributes.begin(), m_attributes.end(), [&name](Attribute *&attr){
         return name==attr->m_name;
     })!=m_attributes.end();
 }
 
-void Element::serializeChildren(QStringList &fragments, bool textOnly)
-{
-    for(auto *eachChild : qAsConst(m_childNodes)) {
-        eachChild->serialize(fragments, textOnly);
-    }
-}
-
 Style::Style(Element *node)
     : QObject(node)
     , m_element(node)
@@ -587,9 +1489,10 @@ Style::Style(Element *node)
 
 QString Style::getStyle(const QString &styleName) const
 {
+    QREADABLE_NATIVE_CALL("Style.getStyle", styleName);
     QString styleAttr = m_element->getAttribute("style");
     if (styleAttr.isEmpty()) {
-        return QString();
+        return QREADABLE_NATIVE_RESULT(QString());
     }
     const QStringList styles = styleAttr.split(";");
     for (const QString &css : styles) {
@@ -599,14 +1502,15 @@ QString Style::getStyle(const QString &styleName) const
         }
         QString name = splitCss.first().trimmed();
         if (name==styleName) {
-            return splitCss.last().trimmed();
+            return QREADABLE_NATIVE_RESULT(splitCss.last().trimmed());
         }
     }
-    return QString();
+    return QREADABLE_NATIVE_RESULT(QString());
 }
 
 void Style::setStyle(const QString &styleName, const QString &styleValue)
 {
+    QREADABLE_NATIVE_CALL("Style.setStyle", styleName, styleValue);
     QString cssText = m_element->getAttribute("style");
     const QString::iterator begin = cssText.begin();
     const QString::iterator end = cssText.end();
@@ -638,10 +1542,12 @@ void Style::setStyle(const QString &styleName, const QString &styleValue)
 
 QString Style::display() const
 {
-    return getStyle("display");
+    QREADABLE_NATIVE_CALL("Style.display");
+    return QREADABLE_NATIVE_RESULT(getStyle("display"));
 }
 
 void Style::setDisplay(const QString &newDisplay)
 {
+    QREADABLE_NATIVE_CALL("Style.display=", newDisplay);
     setStyle("display", newDisplay);
 }
@@ -4,11 +4,14 @@
  */
 #pragma once
 #include <QObject>
+#include <QSet>
 #include <QUrl>
 #include <QVariant>
+#include <memory>
 
 namespace QReadable {
 class DomBuilder;
+class FragmentParser;
 
 namespace DomSupport {
 class Document;
@@ -21,7 +24,9 @@ class Style;
  *
  * This class is designed to be used from JavaScript, and as such
  * does not provide a clean or stable C++ interface to its properties,
- * many of which simply expose member variables.
+ * many of which simply expose member variables.  Properties are
+ * always read through accessors, so that calls from script can be
+ * counted and profiled (see StatsCollector).
  *
  * Nodes take ownership of their added children, and keep them
  * alive until the root node of the tree is destroyed, even if
@@ -52,13 +57,13 @@ public:
     };
     Q_ENUM(NodeType)
 
-    Q_PROPERTY(QList<QReadable::DomSupport::Attribute*> attributes MEMBER m_attributes)
-    Q_PROPERTY(QList<QReadable::DomSupport::Node*> childNodes MEMBER m_childNodes)
-    Q_PROPERTY(QList<QReadable::DomSupport::Element*> children MEMBER m_children)
-    Q_PROPERTY(QString localName MEMBER m_localName)
-    Q_PROPERTY(QReadable::DomSupport::Node *parentNode MEMBER m_parentNode)
-    Q_PROPERTY(QReadable::DomSupport::Node *previousSibling MEMBER m_previousSibling)
-    Q_PROPERTY(QReadable::DomSupport::Node *nextSibling MEMBER m_nextSibling)
+    Q_PROPERTY(QList<QReadable::DomSupport::Attribute*> attributes READ attributes)
+    Q_PROPERTY(QList<QReadable::DomSupport::Node*> childNodes READ childNodes)
+    Q_PROPERTY(QList<QReadable::DomSupport::Element*> children READ elementChildren)
+    Q_PROPERTY(QString localName READ localName)
+    Q_PROPERTY(QReadable::DomSupport::Node *parentNode READ parentNode)
+    Q_PROPERTY(QReadable::DomSupport::Node *previousSibling READ previousSibling)
+    Q_PROPERTY(QReadable::DomSupport::Node *nextSibling READ nextSibling)
     Q_PROPERTY(QReadable::DomSupport::Node *firstChild READ firstChild)
     Q_PROPERTY(QReadable::DomSupport::Element *firstElementChild READ firstElementChild)
     Q_PROPERTY(QReadable::DomSupport::Node *lastChild READ lastChild)
@@ -67,10 +72,26 @@ public:
     Q_PROPERTY(QReadable::DomSupport::Node::NodeType nodeType READ nodeType)
     Q_PROPERTY(QReadable::DomSupport::Document *ownerDocument READ ownerDocument)
 
-    virtual NodeType nodeType() { return UNKNOWN_NODE; }
-    virtual QString nodeName() { return QString(); }
+    ~Node() override;
+    virtual NodeType nodeType();
+    virtual QString nodeName();
+    virtual QString localName() const;
     virtual void serialize(QStringList &fragments, bool textOnly=false){}
+
+    /**
+     * Serialize every descendant of this node into \a fragments
+     *
+     * The tree is walked with an explicit stack, so this works on
+     * arbitrarily deep trees.
+     */
+    void serializeChildren(QStringList &fragments, bool textOnly);
     void clear();
+    QList<QReadable::DomSupport::Attribute*> attributes() const;
+    QList<QReadable::DomSupport::Node*> childNodes() const;
+    QList<QReadable::DomSupport::Element*> elementChildren() const;
+    QReadable::DomSupport::Node *parentNode() const;
+    QReadable::DomSupport::Node *previousSibling() const;
+    QReadable::DomSupport::Node *nextSibling() const;
     QReadable::DomSupport::Node *firstChild() const;
     QReadable::DomSupport::Element *firstElementChild() const;
     QReadable::DomSupport::Node *lastChild() const;
@@ -83,6 +104,23 @@ public:
     Q_INVOKABLE QReadable::DomSupport::Node *removeChild(QReadable::DomSupport::Node *child);
     Q_INVOKABLE QReadable::DomSupport::Node *replaceChild(QReadable::DomSupport::Node *newNode, QReadable::DomSupport::Node *oldNode);
 
+    /**
+     * Append this node's children from \a first up to, but not including,
+     * \a end to \a target's children, in one step
+     *
+     * By default every child is moved.  Nothing is moved if \a first or
+     * \a end aren't children of this node in that order, or if \a target
+     * is one of the moved nodes or inside one.
+     */
+    Q_INVOKABLE void moveChildrenTo(QReadable::DomSupport::Node *target,
+                                    QReadable::DomSupport::Node *first=nullptr,
+                                    QReadable::DomSupport::Node *end=nullptr);
+
+    /**
+     * Called whenever this node gains or loses children
+     */
+    void childrenChanged();
+
     QList<QReadable::DomSupport::Attribute *> m_attributes;
     QList<QReadable::DomSupport::Node *> m_childNodes;
     QList<QReadable::DomSupport::Element *> m_children;
@@ -97,13 +135,16 @@ class Attribute : public Node {
     Q_OBJECT
 
 public:
-    Q_PROPERTY(QString name MEMBER m_name)
-    Q_PROPERTY(QString value MEMBER m_value)
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(QString value READ value WRITE setValue)
 
     Attribute(const QString &name, const QString &value);
 
-    NodeType nodeType() override { return ATTRIBUTE_NODE; }
+    NodeType nodeType() override;
     void serialize(QStringList &fragments, bool textOnly=false) override;
+    QString name() const;
+    QString value() const;
+    void setValue(const QString &value);
 
     Q_INVOKABLE QString getEncodedValue() const;
 
@@ -114,8 +155,8 @@ public:
 class Comment : public Node {
     Q_OBJECT
 public:
-    NodeType nodeType() override { return COMMENT_NODE; }
-    QString nodeName() override { return "#comment"; }
+    NodeType nodeType() override;
+    QString nodeName() override;
 };
 
 class AbstractContentNode : public Node {
@@ -134,8 +175,8 @@ public:
 class Text : public AbstractContentNode {
     Q_OBJECT
 public:
-    NodeType nodeType() override { return TEXT_NODE; }
-    QString nodeName() override { return "#text"; }
+    NodeType nodeType() override;
+    QString nodeName() override;
     QString innerHTML() override;
     void setInnerHTML(const QString &html) override;
     QString textContent() override;
@@ -145,43 +186,122 @@ public:
 private:
     QString m_html;
     QString m_text;
+    QByteArray m_sourceHtml;
     void appendTextContent(const QString &text, const QString &html);
+    void appendTextSource(const QString &text, const char *source, int length);
+    void materializeHtml();
     friend class QReadable::DomBuilder;
+    friend class QReadable::FragmentParser;
 };
 
 class Document : public Node {
     Q_OBJECT
 public:
-    Q_PROPERTY(QString documentURI MEMBER m_url)
-    Q_PROPERTY(QUrl baseURI MEMBER m_baseURI)
+    Q_PROPERTY(QString documentURI READ documentURI)
+    Q_PROPERTY(QUrl baseURI READ baseURI)
     Q_PROPERTY(QReadable::DomSupport::Element *documentElement READ documentElement)
     Q_PROPERTY(QString title READ title)
     Q_PROPERTY(QReadable::DomSupport::Element *body READ body);
     Q_PROPERTY(QReadable::DomSupport::Element *head READ head);
+    Q_PROPERTY(bool qreadable READ isQReadable CONSTANT)
+    Q_PROPERTY(bool metadataCaptured READ metadataCaptured)
+    Q_PROPERTY(QVariant metaValues READ metaValues)
+    Q_PROPERTY(QVariant jsonLd READ jsonLd)
 
     explicit Document(const QString& url);
-    NodeType nodeType() override { return DOCUMENT_NODE; }
-    QString nodeName() override { return "#document"; }
+    NodeType nodeType() override;
+    QString nodeName() override;
     void serialize(QStringList &fragments, bool textOnly=false) override;
+    QString documentURI() const;
+    QUrl baseURI() const;
     Element *documentElement();
     QString title();
     Element *body();
     Element *head();
 
+    /**
+     * Lets Readability.js detect that it can use the native
+     * extensions provided by these classes
+     */
+    bool isQReadable() const { return true; }
+
     Q_INVOKABLE QReadable::DomSupport::Element *getElementById(const QString &id);
     Q_INVOKABLE QReadable::DomSupport::Element *createElement(const QString &tag);
     Q_INVOKABLE QReadable::DomSupport::Text *createTextNode(const QString &text);
 
+    /**
+     * Resolve the URIs in links and media below \a root against the base URI
+     *
+     * This does what Readability.js's _fixRelativeUris() does to href,
+     * src, poster and srcset attributes, except for links to javascript:
+     * URIs, which are returned for script to unwrap.
+     */
+    Q_INVOKABLE QList<QReadable::DomSupport::Element*> resolveRelativeUris(QReadable::DomSupport::Element *root);
+
+    /**
+     * True if DomBuilder recorded the document's metadata as it built it
+     */
+    bool metadataCaptured() const;
+
+    /**
+     * The values of the <meta> tags Readability.js's _getArticleMetadata()
+     * reads, keyed as it keys them
+     */
+    QVariant metaValues() const;
+
+    /**
+     * The first schema.org article in the document's JSON-LD scripts,
+     * as Readability.js's _getJSONLD() finds it, or undefined
+     */
+    QVariant jsonLd() const;
+
+    /**
+     * Record a <meta> tag's attributes, if it is one metaValues() keeps
+     */
+    void addMetaTag(const QString &name, const QString &property, const QString &content);
+
     QString m_url;
     QUrl m_baseURI;
+
+    /**
+     * The UTF-8 source the document was built from
+     *
+     * Text nodes refer to their original HTML in the source rather than
+     * copying it, so it must live as long as the document.  m_sourceOwner
+     * keeps alive whatever storage m_source points to, if it doesn't
+     * own its data.
+     */
+    QByteArray m_source;
+    std::shared_ptr<const void> m_sourceOwner;
+
+    bool m_metadataCaptured{false};
+    QVariantMap m_metaValues;
+    QStringList m_jsonLdScripts;
+
+private:
+    /**
+     * The head, body and title elements, once found
+     *
+     * Each is only cached if it is where a parser puts it, within a few
+     * levels of the document element, so that Node::childrenChanged()
+     * need only look a few levels up to know when to forget them.
+     */
+    Element *m_head{nullptr};
+    Element *m_body{nullptr};
+    Element *m_titleElement{nullptr};
+
+    // the first \a tag element, cached if it is \a depth levels below the document element
+    Element *structuralElement(Element *&cache, const QString &tag, int depth);
+    void structureChanged();
+    friend class Node;
 };
 
 class Element : public AbstractContentNode {
     Q_OBJECT
 public:
     Q_PROPERTY(QString tagName READ tagName)
-    Q_PROPERTY(Element *previousElementSibling MEMBER m_previousElementSibling)
-    Q_PROPERTY(Element *nextElementSibling MEMBER m_nextElementSibling)
+    Q_PROPERTY(Element *previousElementSibling READ previousElementSibling)
+    Q_PROPERTY(Element *nextElementSibling READ nextElementSibling)
     Q_PROPERTY(Style *style READ style)
     Q_PROPERTY(QString className READ className WRITE setClassName)
     Q_PROPERTY(QString id READ id WRITE setId)
@@ -189,12 +309,16 @@ public:
     Q_PROPERTY(QString src READ src WRITE setSrc)
     Q_PROPERTY(QString srcset READ srcset WRITE setSrcset)
     Q_PROPERTY(QString localName READ localName)
+    Q_PROPERTY(int classifierFlags READ classifierFlags)
+    Q_PROPERTY(QVariantMap tableShape READ tableShape)
+    Q_PROPERTY(bool dataTable READ isDataTable)
 
     explicit Element(const QString &tag);
     explicit Element(int gumboTag);
+    ~Element() override;
 
-    NodeType nodeType() override { return ELEMENT_NODE; }
-    QString nodeName() override { return m_tagName; }
+    NodeType nodeType() override;
+    QString nodeName() override;
     void serialize(QStringList &fragments, bool textOnly=false) override;
     QString innerHTML() override;
     void setInnerHTML(const QString &html) override;
@@ -212,10 +336,57 @@ public:
     QString srcset() const;
     void setSrcset(const QString &newSrcset);
     QString tagName() const;
-    void setTagName(const QString &tagName);
-    QString localName();
+    QString localName() const override;
+    Element *previousElementSibling() const;
+    Element *nextElementSibling() const;
     int gumboTag() const;
 
+    /**
+     * Which of Readability's class/id patterns match this element
+     *
+     * The result is a set of Classifier::Flag values.  It is computed
+     * on first use and cached until the class or id attribute changes.
+     */
+    int classifierFlags() const;
+
+    /**
+     * What Readability.js's _markDataTables() looks at below a table
+     *
+     * The rows and columns it counts with _getRowAndColumnCount(), and
+     * whether there is a non-empty caption, a data-y descendant (col,
+     * colgroup, tfoot, thead or th) or a nested table, all found in one
+     * walk.  The result is cached until any tree on this thread changes.
+     */
+    QVariantMap tableShape() const;
+
+    /**
+     * Whether _markDataTables() would consider this a data table rather
+     * than a layout table
+     */
+    bool isDataTable() const;
+
+    /**
+     * Change this element's tag in place, keeping its children and attributes
+     *
+     * Returns this element, so that script can use it like the
+     * replacement element Readability.js's _setNodeTag() creates elsewhere.
+     */
+    Q_INVOKABLE QReadable::DomSupport::Element *renameTag(const QString &tag);
+
+    /**
+     * Remove every class not in \a classesToPreserve from this element and
+     * its descendants, as Readability.js's _cleanClasses() does
+     */
+    Q_INVOKABLE void cleanClasses(const QStringList &classesToPreserve);
+
+    /**
+     * Remove \a attributes from this element and its descendants, and
+     * width and height from those whose tagName is in \a sizeAttributeTags,
+     * leaving <svg> elements and their contents alone, as Readability.js's
+     * _cleanStyles() does
+     */
+    Q_INVOKABLE void cleanStyles(const QStringList &attributes, const QStringList &sizeAttributeTags);
+
     Q_INVOKABLE QString getAttribute(const QString &name) const;
     Q_INVOKABLE void setAttribute(const QString &name, const QString &value);
     Q_INVOKABLE void removeAttribute(const QString &name);
@@ -226,9 +397,18 @@ public:
 
 private:
     QString m_tagName;
-    mutable int m_gumboTag{-1};
+    int m_gumboTag;
+    mutable int m_classifierFlags{-1};
+    struct TableShape;
+    mutable std::unique_ptr<TableShape> m_tableShape;
+    const TableShape &measureTable() const;
     Style *m_style{nullptr};
-    void serializeChildren(QStringList &fragments, bool textOnly);
+    void setTag(const QString &tag);
+    void attributeChanged(const QString &name);
+    void removeAttributes(const QSet<QString> &names);
+    void serializeStartTag(QStringList &fragments);
+    friend class Node;
+    friend class Attribute;
 };
 
 class Style : public QObject {
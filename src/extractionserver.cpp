@@ -0,0 +1,427 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "extractionserver.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtEndian>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "workerpool.h"
+using namespace QReadable;
+
+// the largest frame a client may send
+static constexpr quint32 kMaxFrameSize = 256 * 1024 * 1024;
+
+// how many requests a single connection may have in flight
+static constexpr int kMaxPipelined = 32;
+
+// stop reading requests from a client that has this much unread output
+static constexpr qint64 kMaxUnsentBytes = 16 * 1024 * 1024;
+
+// how long a drain waits for clients to take their last responses
+static constexpr int kDrainTimeoutMs = 5000;
+
+namespace {
+struct Connection {
+    quint64 id;
+    QIODevice *socket;
+    QJsonObject header;
+    bool haveHeader{false};
+    quint64 nextSequence{0};
+    quint64 nextToSend{0};
+    std::map<quint64, QByteArray> finished;
+    int inFlight{0};
+    // after a protocol error nothing more is read, and the socket closes after response lastToSend
+    bool dead{false};
+    quint64 lastToSend{0};
+};
+
+enum class FrameResult { Incomplete, Complete, TooLarge };
+}
+
+struct ExtractionServer::PrivData {
+    PrivData(int workers, const ReadableOptions &options, std::shared_ptr<ResultCache> cache)
+        : options{options}
+        , pool{workers, options, [](const QJsonObject &){}, std::move(cache)}
+        // requests in flight never outnumber the queue, so submitting never blocks
+        , maxInFlight{pool.queueCapacity()}
+    {
+    }
+
+    ExtractionServer *q;
+    ReadableOptions options;
+    WorkerPool pool;
+    QLocalServer localServer;
+    QTcpServer tcpServer;
+    std::unordered_map<quint64, std::unique_ptr<Connection>> connections;
+    quint64 nextConnectionId{1};
+    int inFlight{0};
+    int maxInFlight;
+    bool draining{false};
+    bool closingAll{false};
+    bool drained{false};
+    QString error;
+
+    Connection *findConnection(quint64 connectionId);
+    void accept(QIODevice *socket);
+    void readRequests(Connection *connection);
+    void readAllConnections();
+    void submit(Connection *connection, const QByteArray &html);
+    void finishRequest(quint64 connectionId, quint64 sequence, const QJsonObject &record);
+    void finishLater(quint64 connectionId, quint64 sequence, const QJsonObject &record);
+    void sendFinished(Connection *connection);
+    void protocolError(Connection *connection, const QString &message);
+    void closeConnection(quint64 connectionId);
+    void checkDrained();
+};
+
+static FrameResult readFrame(QIODevice *socket, QByteArray &frame)
+{
+    uchar prefix[4];
+    if (socket->peek(reinterpret_cast<char *>(prefix), sizeof(prefix)) < qint64(sizeof(prefix))) {
+        return FrameResult::Incomplete;
+    }
+    quint32 length = qFromBigEndian<quint32>(prefix);
+    if (length > kMaxFrameSize) {
+        return FrameResult::TooLarge;
+    }
+    if (socket->bytesAvailable() < qint64(sizeof(prefix)) + length) {
+        return FrameResult::Incomplete;
+    }
+    socket->read(sizeof(prefix));
+    frame = socket->read(length);
+    return FrameResult::Complete;
+}
+
+static QByteArray toFrame(const QJsonObject &record)
+{
+    QByteArray payload = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    QByteArray frame(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), frame.data());
+    return frame + payload;
+}
+
+// Apply the options in a request header on top of the server's options
+static bool readOptions(const QJsonObject &header, ReadableOptions &options, QString &error)
+{
+    if (header.contains("maxElemsToParse")) {
+        options.maxElemsToParse = header.value("maxElemsToParse").toInt();
+    }
+    if (header.contains("nbTopCandidates")) {
+        options.nbTopCandidates = header.value("nbTopCandidates").toInt();
+    }
+    if (header.contains("charThreshold")) {
+        options.charThreshold = header.value("charThreshold").toInt();
+    }
+    if (header.contains("keepClasses")) {
+        options.keepClasses = header.value("keepClasses").toBool();
+    }
+    if (header.contains("disableJSONLD")) {
+        options.disableJSONLD = header.value("disableJSONLD").toBool();
+    }
+    if (header.contains("classesToPreserve")) {
+        options.classesToPreserve.clear();
+        const QJsonArray classes = header.value("classesToPreserve").toArray();
+        for (const QJsonValue &className : classes) {
+            options.classesToPreserve << className.toString();
+        }
+    }
+    if (header.contains("format") && !parseOutputFormat(header.value("format").toString(), options.outputFormat)) {
+        error = QStringLiteral("unknown format: %1").arg(header.value("format").toString());
+        return false;
+    }
+    return true;
+}
+
+static void closeSocket(QIODevice *socket)
+{
+    if (auto *localSocket = qobject_cast<QLocalSocket *>(socket)) {
+        localSocket->disconnectFromServer();
+    } else if (auto *tcpSocket = qobject_cast<QTcpSocket *>(socket)) {
+        tcpSocket->disconnectFromHost();
+    }
+}
+
+static void abortSocket(QIODevice *socket)
+{
+    if (auto *localSocket = qobject_cast<QLocalSocket *>(socket)) {
+        localSocket->abort();
+    } else if (auto *tcpSocket = qobject_cast<QTcpSocket *>(socket)) {
+        tcpSocket->abort();
+    }
+}
+
+ExtractionServer::ExtractionServer(int workers, const ReadableOptions &options, std::shared_ptr<ResultCache> cache, QObject *parent)
+    : QObject(parent)
+    , d{std::make_unique<PrivData>(workers, options, std::move(cache))}
+{
+    d->q = this;
+    connect(&d->localServer, &QLocalServer::newConnection, this, [this]{
+        while (QLocalSocket *socket = d->localServer.nextPendingConnection()) {
+            d->accept(socket);
+        }
+    });
+    connect(&d->tcpServer, &QTcpServer::newConnection, this, [this]{
+        while (QTcpSocket *socket = d->tcpServer.nextPendingConnection()) {
+            d->accept(socket);
+        }
+    });
+}
+
+ExtractionServer::~ExtractionServer()
+{
+    // no results can be delivered after this
+    d->pool.finish();
+}
+
+bool ExtractionServer::listenLocal(const QString &path)
+{
+    QLocalServer::removeServer(path);
+    if (!d->localServer.listen(path)) {
+        d->error = d->localServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ExtractionServer::listenTcp(quint16 port)
+{
+    if (!d->tcpServer.listen(QHostAddress::LocalHost, port)) {
+        d->error = d->tcpServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString ExtractionServer::errorString() const
+{
+    return d->error;
+}
+
+void ExtractionServer::drain()
+{
+    d->draining = true;
+    d->localServer.close();
+    d->tcpServer.close();
+    d->checkDrained();
+}
+
+Connection *ExtractionServer::PrivData::findConnection(quint64 connectionId)
+{
+    auto found = connections.find(connectionId);
+    return found == connections.end() ? nullptr : found->second.get();
+}
+
+void ExtractionServer::PrivData::accept(QIODevice *socket)
+{
+    if (draining) {
+        closeSocket(socket);
+        socket->deleteLater();
+        return;
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->id = nextConnectionId++;
+    connection->socket = socket;
+    quint64 id = connection->id;
+    connections.emplace(id, std::move(connection));
+
+    auto readMore = [this, id]{
+        if (Connection *connection = findConnection(id)) {
+            readRequests(connection);
+        }
+    };
+    QObject::connect(socket, &QIODevice::readyRead, q, readMore);
+    QObject::connect(socket, &QIODevice::bytesWritten, q, readMore);
+    if (auto *localSocket = qobject_cast<QLocalSocket *>(socket)) {
+        QObject::connect(localSocket, &QLocalSocket::disconnected, q, [this, id]{ closeConnection(id); });
+    } else if (auto *tcpSocket = qobject_cast<QTcpSocket *>(socket)) {
+        QObject::connect(tcpSocket, &QTcpSocket::disconnected, q, [this, id]{ closeConnection(id); });
+    }
+    readMore();
+}
+
+void ExtractionServer::PrivData::readRequests(Connection *connection)
+{
+    if (connection->dead) {
+        // whatever follows a protocol error is discarded unread
+        connection->socket->skip(connection->socket->bytesAvailable());
+        return;
+    }
+    while (!draining && inFlight < maxInFlight && connection->inFlight < kMaxPipelined
+           && connection->socket->bytesToWrite() < kMaxUnsentBytes) {
+        QByteArray frame;
+        FrameResult result = readFrame(connection->socket, frame);
+        if (result == FrameResult::Incomplete) {
+            return;
+        }
+        if (result == FrameResult::TooLarge) {
+            protocolError(connection, QStringLiteral("frame too large"));
+            return;
+        }
+        if (!connection->haveHeader) {
+            QJsonDocument header = QJsonDocument::fromJson(frame);
+            if (!header.isObject()) {
+                protocolError(connection, QStringLiteral("request header is not a JSON object"));
+                return;
+            }
+            connection->header = header.object();
+            connection->haveHeader = true;
+        } else {
+            connection->haveHeader = false;
+            submit(connection, frame);
+        }
+    }
+}
+
+void ExtractionServer::PrivData::readAllConnections()
+{
+    // reading can close connections, so don't iterate over the map itself
+    std::vector<quint64> ids;
+    ids.reserve(connections.size());
+    for (const auto &connection : connections) {
+        ids.push_back(connection.first);
+    }
+    for (quint64 id : ids) {
+        if (inFlight >= maxInFlight) {
+            return;
+        }
+        if (Connection *connection = findConnection(id)) {
+            readRequests(connection);
+        }
+    }
+}
+
+void ExtractionServer::PrivData::submit(Connection *connection, const QByteArray &html)
+{
+    const QJsonObject &header = connection->header;
+    quint64 connectionId = connection->id;
+    quint64 sequence = connection->nextSequence++;
+    connection->inFlight++;
+    inFlight++;
+
+    ExtractionJob job;
+    job.html = html;
+    job.url = QUrl(header.value("url").toString());
+    if (header.contains("id")) {
+        job.fields.insert("id", header.value("id"));
+    }
+
+    ReadableOptions requestOptions = options;
+    QString optionsError;
+    if (!readOptions(header, requestOptions, optionsError)) {
+        QJsonObject record = job.fields;
+        record.insert("error", optionsError);
+        finishLater(connectionId, sequence, record);
+        return;
+    }
+    if (requestOptions != options) {
+        job.options = requestOptions;
+    }
+    job.limits.timeout = std::chrono::milliseconds(header.value("timeoutMs").toInt());
+
+    job.onResult = [this, connectionId, sequence](const QJsonObject &record) {
+        finishLater(connectionId, sequence, record);
+    };
+    pool.submit(std::move(job));
+}
+
+// Finish a request on the server's thread once control returns to the event loop
+void ExtractionServer::PrivData::finishLater(quint64 connectionId, quint64 sequence, const QJsonObject &record)
+{
+    QMetaObject::invokeMethod(q, [this, connectionId, sequence, record]{
+        finishRequest(connectionId, sequence, record);
+    }, Qt::QueuedConnection);
+}
+
+void ExtractionServer::PrivData::finishRequest(quint64 connectionId, quint64 sequence, const QJsonObject &record)
+{
+    inFlight--;
+    if (Connection *connection = findConnection(connectionId)) {
+        connection->inFlight--;
+        connection->finished.emplace(sequence, toFrame(record));
+        sendFinished(connection);
+    }
+    readAllConnections();
+    checkDrained();
+}
+
+void ExtractionServer::PrivData::sendFinished(Connection *connection)
+{
+    // responses go out in request order
+    while (!connection->finished.empty() && connection->finished.begin()->first == connection->nextToSend) {
+        connection->socket->write(connection->finished.begin()->second);
+        connection->finished.erase(connection->finished.begin());
+        connection->nextToSend++;
+    }
+    if (connection->dead && connection->nextToSend > connection->lastToSend) {
+        closeSocket(connection->socket);
+    }
+}
+
+// The error is answered after the requests before it, and then the connection is closed
+void ExtractionServer::PrivData::protocolError(Connection *connection, const QString &message)
+{
+    QJsonObject record;
+    record.insert("error", message);
+    connection->dead = true;
+    connection->lastToSend = connection->nextSequence++;
+    connection->finished.emplace(connection->lastToSend, toFrame(record));
+    sendFinished(connection);
+}
+
+void ExtractionServer::PrivData::closeConnection(quint64 connectionId)
+{
+    auto found = connections.find(connectionId);
+    if (found == connections.end()) {
+        return;
+    }
+    // results still being computed for this connection are discarded
+    found->second->socket->deleteLater();
+    connections.erase(found);
+    checkDrained();
+}
+
+void ExtractionServer::PrivData::checkDrained()
+{
+    if (!draining || drained || inFlight > 0) {
+        return;
+    }
+    if (!closingAll) {
+        closingAll = true;
+        // closing a socket can remove its connection from the map
+        std::vector<QIODevice *> sockets;
+        for (const auto &connection : connections) {
+            sockets.push_back(connection.second->socket);
+        }
+        // each socket disconnects once its last responses have been written
+        for (QIODevice *socket : sockets) {
+            closeSocket(socket);
+        }
+        QTimer::singleShot(kDrainTimeoutMs, q, [this]{
+            std::vector<quint64> ids;
+            for (const auto &connection : connections) {
+                ids.push_back(connection.first);
+            }
+            for (quint64 id : ids) {
+                if (Connection *connection = findConnection(id)) {
+                    abortSocket(connection->socket);
+                    closeConnection(id);
+                }
+            }
+        });
+    }
+    // the last disconnection finishes the drain
+    if (drained || !connections.empty()) {
+        return;
+    }
+    drained = true;
+    emit q->drained();
+}
@@ -0,0 +1,66 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QObject>
+#include <memory>
+#include "readable.h"
+
+namespace QReadable {
+class ResultCache;
+
+/**
+ * Serves extraction requests from a pool of warm Readable engines
+ *
+ * Clients connect over a Unix domain socket or a TCP port on the loopback
+ * interface and exchange frames, each of which is a 32-bit big-endian
+ * length followed by that many bytes.  A request is two frames: a JSON
+ * object with the document's "url", an optional "id" and optional
+ * Readable options ("format", "keepClasses", "charThreshold", etc. and
+ * "timeoutMs"), followed by the UTF-8 encoded HTML.  Each request is
+ * answered by one frame holding a JSON result record, which echoes the
+ * request's "id".
+ *
+ * Requests may be pipelined; responses on a connection are sent in
+ * request order.  When too many requests are in flight the server stops
+ * reading from its clients until workers become free.
+ */
+class ExtractionServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    ExtractionServer(int workers, const ReadableOptions &options, std::shared_ptr<ResultCache> cache=nullptr, QObject *parent=nullptr);
+    ~ExtractionServer();
+
+    /**
+     * Listen on the Unix domain socket at \a path, replacing any stale socket file
+     */
+    bool listenLocal(const QString &path);
+
+    /**
+     * Listen on \a port on the loopback interface
+     */
+    bool listenTcp(quint16 port);
+
+    QString errorString() const;
+
+    /**
+     * Stop accepting connections and requests, and emit drained() once
+     * every request already being processed has been answered
+     *
+     * Each client is disconnected once it has been sent its last
+     * responses, or after a few seconds if it stops reading them.
+     */
+    void drain();
+
+signals:
+    void drained();
+
+private:
+    struct PrivData;
+    std::unique_ptr<PrivData> d;
+};
+}
@@ -0,0 +1,187 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "fetcher.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QNetworkReply>
+#include <deque>
+using namespace QReadable;
+
+bool QReadable::isHtmlContentType(const QByteArray &contentType)
+{
+    QByteArray mimeType = contentType.split(';').first().trimmed().toLower();
+    return mimeType == "text/html" || mimeType == "application/xhtml+xml";
+}
+
+namespace {
+struct Download {
+    QNetworkReply *reply;
+    QString host;
+    QElapsedTimer timer;
+};
+}
+
+struct Fetcher::PrivData {
+    Fetcher *q;
+    WorkerPool *pool;
+    WorkerPool::ResultHandler handler;
+    FetchOptions options;
+    QNetworkAccessManager nam;
+
+    // URLs not yet requested, by host, and the hosts that have some, in turn
+    QHash<QString, std::deque<QUrl>> waiting;
+    std::deque<QString> waitingHosts;
+    QHash<QString, int> activePerHost;
+    int active{0};
+
+    // downloaded pages held back while the pool is busy
+    std::deque<ExtractionJob> downloaded;
+    int extracting{0};
+    int maxExtracting;
+
+    bool adding{true};
+    bool done{false};
+
+    void startDownloads();
+    void downloadFinished(Download download);
+    void submitDownloaded();
+    void checkFinished();
+};
+
+Fetcher::Fetcher(WorkerPool *pool, const FetchOptions &options, WorkerPool::ResultHandler handler, QObject *parent)
+    : QObject(parent)
+    , d{std::make_unique<PrivData>()}
+{
+    d->q = this;
+    d->pool = pool;
+    d->handler = std::move(handler);
+    d->options = options;
+    d->maxExtracting = pool->queueCapacity();
+    if (!options.cacheDirectory.isEmpty()) {
+        auto *cache = new QNetworkDiskCache(&d->nam);
+        cache->setCacheDirectory(options.cacheDirectory);
+        cache->setMaximumCacheSize(options.maxCacheBytes);
+        d->nam.setCache(cache);
+    }
+}
+
+Fetcher::~Fetcher() = default;
+
+void Fetcher::add(const QUrl &url)
+{
+    QString host = url.host();
+    auto &hostQueue = d->waiting[host];
+    if (hostQueue.empty()) {
+        d->waitingHosts.push_back(host);
+    }
+    hostQueue.push_back(url);
+    d->startDownloads();
+}
+
+void Fetcher::finishAdding()
+{
+    d->adding = false;
+    d->checkFinished();
+}
+
+void Fetcher::PrivData::startDownloads()
+{
+    // go round the hosts in turn, skipping those at their limit
+    size_t hostsToTry = waitingHosts.size();
+    while (hostsToTry > 0 && active < options.maxConcurrent && downloaded.empty()) {
+        QString host = waitingHosts.front();
+        waitingHosts.pop_front();
+        hostsToTry--;
+        int &hostActive = activePerHost[host];
+        if (hostActive >= options.maxPerHost) {
+            waitingHosts.push_back(host);
+            continue;
+        }
+
+        auto found = waiting.find(host);
+        QUrl url = found->front();
+        found->pop_front();
+        if (found->empty()) {
+            waiting.erase(found);
+        } else {
+            waitingHosts.push_back(host);
+            hostsToTry++;
+        }
+
+        QNetworkRequest request(url);
+        request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+        // use the cache, but revalidate stale entries with a conditional request
+        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork);
+        Download download{nam.get(request), host, QElapsedTimer()};
+        download.timer.start();
+        hostActive++;
+        active++;
+        QObject::connect(download.reply, &QNetworkReply::finished, q, [this, download]{
+            downloadFinished(download);
+        });
+    }
+}
+
+void Fetcher::PrivData::downloadFinished(Download download)
+{
+    QNetworkReply *reply = download.reply;
+    reply->deleteLater();
+    active--;
+    activePerHost[download.host]--;
+
+    QJsonObject fields;
+    fields.insert("requestUrl", reply->request().url().toString());
+    fields.insert("httpStatus", reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt());
+    fields.insert("fromCache", reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool());
+    fields.insert("fetchMs", download.timer.nsecsElapsed() / 1e6);
+
+    QByteArray contentType = reply->header(QNetworkRequest::ContentTypeHeader).toByteArray();
+    if (reply->error() != QNetworkReply::NoError || !isHtmlContentType(contentType)) {
+        QJsonObject record = fields;
+        record.insert("url", reply->url().toString());
+        record.insert("error", reply->error() != QNetworkReply::NoError ?
+                          reply->errorString() :
+                          QStringLiteral("not HTML: %1").arg(QString::fromLatin1(contentType)));
+        handler(record);
+    } else {
+        ExtractionJob job;
+        job.html = reply->readAll();
+        job.url = reply->url();
+        job.fields = fields;
+        job.onResult = [this](const QJsonObject &record) {
+            handler(record);
+            QMetaObject::invokeMethod(q, [this]{
+                extracting--;
+                submitDownloaded();
+                startDownloads();
+                checkFinished();
+            }, Qt::QueuedConnection);
+        };
+        downloaded.push_back(std::move(job));
+        submitDownloaded();
+    }
+    startDownloads();
+    checkFinished();
+}
+
+void Fetcher::PrivData::submitDownloaded()
+{
+    while (!downloaded.empty() && extracting < maxExtracting) {
+        extracting++;
+        pool->submit(std::move(downloaded.front()));
+        downloaded.pop_front();
+    }
+}
+
+void Fetcher::PrivData::checkFinished()
+{
+    if (adding || done || active > 0 || extracting > 0 || !downloaded.empty() || !waiting.isEmpty()) {
+        return;
+    }
+    done = true;
+    emit q->finished();
+}
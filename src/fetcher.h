@@ -0,0 +1,67 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QObject>
+#include <QUrl>
+#include <memory>
+#include "workerpool.h"
+
+namespace QReadable {
+/**
+ * True if \a contentType (a Content-Type header value) is HTML
+ */
+bool isHtmlContentType(const QByteArray &contentType);
+
+struct FetchOptions {
+    /** The most requests in progress at once */
+    int maxConcurrent{16};
+
+    /** The most requests in progress to any one host */
+    int maxPerHost{4};
+
+    /** Where to keep the HTTP cache, or empty for no cache */
+    QString cacheDirectory;
+
+    /** The most to keep in the HTTP cache, in bytes */
+    qint64 maxCacheBytes{1024 * 1024 * 1024};
+};
+
+/**
+ * Downloads a list of pages concurrently and extracts them on a WorkerPool
+ *
+ * Requests are spread across hosts, with at most FetchOptions::maxPerHost
+ * in progress to any one host.  Connections are kept alive and reused,
+ * responses are decompressed, and if a cache directory is set, responses
+ * are cached and revalidated with conditional requests.  Each page is
+ * handed to the pool as soon as it has downloaded, so extraction overlaps
+ * with the remaining downloads.  Pages that fail to download are
+ * reported to the result handler with an "error" field.
+ *
+ * The Fetcher must live on a thread with an event loop.
+ */
+class Fetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    Fetcher(WorkerPool *pool, const FetchOptions &options, WorkerPool::ResultHandler handler, QObject *parent=nullptr);
+    ~Fetcher();
+
+    void add(const QUrl &url);
+
+    /**
+     * Call once every URL has been added; finished() is emitted when they have all been processed
+     */
+    void finishAdding();
+
+signals:
+    void finished();
+
+private:
+    struct PrivData;
+    std::unique_ptr<PrivData> d;
+};
+}
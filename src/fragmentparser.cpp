@@ -0,0 +1,455 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "fragmentparser.h"
+#include <QScopedValueRollback>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "dombuilder.h"
+#include "domsupport.h"
+using namespace QReadable;
+using namespace QReadable::DomSupport;
+
+namespace {
+/**
+ * Memory handed to Gumbo while one fragment is parsed, released all at once afterwards
+ *
+ * Every block is preceded by its size, so that realloc can copy it.
+ * Freeing a block does nothing, and the parse tree is not destroyed at
+ * all; the arena is reset once it has been built from.
+ */
+class Arena
+{
+public:
+    ~Arena();
+    void *reallocate(void *ptr, size_t size);
+    void reset();
+
+private:
+    struct Chunk {
+        char *data;
+        size_t size;
+        size_t used;
+    };
+    // chunks of kChunkSize, filled in turn; m_current is the one being filled
+    std::vector<Chunk> m_chunks;
+    size_t m_current{0};
+    // blocks too large for a chunk, each allocated on its own
+    std::vector<Chunk> m_large;
+
+    void *allocate(size_t size);
+};
+}
+
+static constexpr size_t kAlignment = alignof(std::max_align_t);
+static constexpr size_t kHeaderSize = kAlignment;
+static constexpr size_t kChunkSize = 64 * 1024;
+// the chunks kept for the next fragment
+static constexpr size_t kRetainedChunks = 16;
+static constexpr int kInitialUtf8Bytes = 64 * 1024;
+// UTF-8 buffers larger than this are freed after use
+static constexpr int kRetainedUtf8Bytes = 1024 * 1024;
+
+static size_t roundUp(size_t size)
+{
+    return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+static size_t &blockSize(void *block)
+{
+    return *reinterpret_cast<size_t *>(static_cast<char *>(block) - kHeaderSize);
+}
+
+Arena::~Arena()
+{
+    reset();
+    for (Chunk &chunk : m_chunks) {
+        std::free(chunk.data);
+    }
+}
+
+void *Arena::allocate(size_t size)
+{
+    size_t needed = kHeaderSize + roundUp(size);
+    char *header;
+    if (needed > kChunkSize) {
+        header = static_cast<char *>(std::malloc(needed));
+        if (!header) {
+            return nullptr;
+        }
+        m_large.push_back({header, needed, needed});
+    } else {
+        while (m_current < m_chunks.size() && m_chunks[m_current].size - m_chunks[m_current].used < needed) {
+            m_current++;
+        }
+        if (m_current == m_chunks.size()) {
+            char *data = static_cast<char *>(std::malloc(kChunkSize));
+            if (!data) {
+                return nullptr;
+            }
+            m_chunks.push_back({data, kChunkSize, 0});
+        }
+        Chunk &chunk = m_chunks[m_current];
+        header = chunk.data + chunk.used;
+        chunk.used += needed;
+    }
+    void *block = header + kHeaderSize;
+    blockSize(block) = size;
+    return block;
+}
+
+void *Arena::reallocate(void *ptr, size_t size)
+{
+    if (!ptr) {
+        return allocate(size);
+    }
+    size_t oldSize = blockSize(ptr);
+    if (size <= oldSize) {
+        return ptr;
+    }
+
+    // Gumbo's vectors and string buffers usually grow the block they last allocated
+    char *end = static_cast<char *>(ptr) + roundUp(oldSize);
+    if (m_current < m_chunks.size()) {
+        Chunk &chunk = m_chunks[m_current];
+        size_t growth = roundUp(size) - roundUp(oldSize);
+        if (end == chunk.data + chunk.used && chunk.size - chunk.used >= growth) {
+            chunk.used += growth;
+            blockSize(ptr) = size;
+            return ptr;
+        }
+    }
+
+    void *moved = allocate(size);
+    if (moved) {
+        std::memcpy(moved, ptr, oldSize);
+    }
+    return moved;
+}
+
+void Arena::reset()
+{
+    for (Chunk &chunk : m_large) {
+        std::free(chunk.data);
+    }
+    m_large.clear();
+    while (m_chunks.size() > kRetainedChunks) {
+        std::free(m_chunks.back().data);
+        m_chunks.pop_back();
+    }
+    for (Chunk &chunk : m_chunks) {
+        chunk.used = 0;
+    }
+    m_current = 0;
+}
+
+// The arena Gumbo allocates from on this thread, if a fragment is being parsed.
+// Gumbo only reallocates and frees memory from the parse it is running, and
+// trees parsed outside an arena are never destroyed inside one, so every block
+// it passes in while an arena is active came from that arena.
+static thread_local Arena *activeArena = nullptr;
+
+static void *gumboRealloc(void *ptr, size_t size)
+{
+    if (Arena *arena = activeArena) {
+        return arena->reallocate(ptr, size);
+    }
+    return std::realloc(ptr, size);
+}
+
+static void gumboFree(void *ptr)
+{
+    if (activeArena) {
+        return;
+    }
+    std::free(ptr);
+}
+
+// Gumbo's allocator is process-wide, so it is replaced once, before main(),
+// and only uses an arena on threads that are parsing a fragment
+static const bool gumboAllocatorInstalled = [] {
+    gumbo_memory_set_allocator(gumboRealloc);
+    gumbo_memory_set_free(gumboFree);
+    return true;
+}();
+
+namespace {
+// Makes Gumbo allocate from an arena on this thread, and resets the arena afterwards
+class ArenaScope
+{
+public:
+    explicit ArenaScope(Arena &arena)
+        : m_arena(arena)
+        , m_previous(activeArena)
+    {
+        activeArena = &arena;
+    }
+
+    ~ArenaScope()
+    {
+        activeArena = m_previous;
+        m_arena.reset();
+    }
+
+private:
+    Arena &m_arena;
+    Arena *m_previous;
+};
+}
+
+// Like QString::toUtf8(), but into the existing storage of \a out
+static void encodeUtf8(const QString &text, QByteArray &out)
+{
+    out.resize(text.size() * 3);
+    uchar *begin = reinterpret_cast<uchar *>(out.data());
+    uchar *dst = begin;
+    const ushort *src = text.utf16();
+    const ushort *end = src + text.size();
+    while (src < end) {
+        ushort c = *src++;
+        if (c < 0x80) {
+            *dst++ = uchar(c);
+        } else if (c < 0x800) {
+            *dst++ = uchar(0xc0 | (c >> 6));
+            *dst++ = uchar(0x80 | (c & 0x3f));
+        } else if (QChar::isHighSurrogate(c) && src < end && QChar::isLowSurrogate(*src)) {
+            uint u = QChar::surrogateToUcs4(c, *src++);
+            *dst++ = uchar(0xf0 | (u >> 18));
+            *dst++ = uchar(0x80 | ((u >> 12) & 0x3f));
+            *dst++ = uchar(0x80 | ((u >> 6) & 0x3f));
+            *dst++ = uchar(0x80 | (u & 0x3f));
+        } else if (QChar::isSurrogate(c)) {
+            // as QString::toUtf8() does
+            *dst++ = '?';
+        } else {
+            *dst++ = uchar(0xe0 | (c >> 12));
+            *dst++ = uchar(0x80 | ((c >> 6) & 0x3f));
+            *dst++ = uchar(0x80 | (c & 0x3f));
+        }
+    }
+    out.resize(int(dst - begin));
+}
+
+// True if text in a \a context element is tokenized and inserted as in a body element
+static bool isFlowContext(GumboTag context)
+{
+    switch (context) {
+    case GUMBO_TAG_HTML:
+    case GUMBO_TAG_HEAD:
+    case GUMBO_TAG_TITLE:
+    case GUMBO_TAG_TEXTAREA:
+    case GUMBO_TAG_STYLE:
+    case GUMBO_TAG_XMP:
+    case GUMBO_TAG_IFRAME:
+    case GUMBO_TAG_NOEMBED:
+    case GUMBO_TAG_NOFRAMES:
+    case GUMBO_TAG_NOSCRIPT:
+    case GUMBO_TAG_SCRIPT:
+    case GUMBO_TAG_PLAINTEXT:
+    case GUMBO_TAG_TABLE:
+    case GUMBO_TAG_CAPTION:
+    case GUMBO_TAG_COLGROUP:
+    case GUMBO_TAG_TBODY:
+    case GUMBO_TAG_THEAD:
+    case GUMBO_TAG_TFOOT:
+    case GUMBO_TAG_TR:
+    case GUMBO_TAG_SELECT:
+    case GUMBO_TAG_OPTGROUP:
+    case GUMBO_TAG_OPTION:
+    case GUMBO_TAG_TEMPLATE:
+    case GUMBO_TAG_FRAMESET:
+    case GUMBO_TAG_UNKNOWN:
+    case GUMBO_TAG_LAST:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// True if \a codePoint is one the tokenizer emits unchanged from a numeric reference
+static bool isPlainCodePoint(uint codePoint)
+{
+    if (codePoint < 0xa0) {
+        return codePoint == '\t' || codePoint == '\n' || (codePoint >= 0x20 && codePoint < 0x7f);
+    }
+    if (codePoint >= 0xd800 && codePoint < 0xe000) {
+        return false;
+    }
+    if (codePoint >= 0xfdd0 && codePoint <= 0xfdef) {
+        return false;
+    }
+    return (codePoint & 0xfffe) != 0xfffe && codePoint <= 0x10ffff;
+}
+
+// Decode the character reference after the '&' at \a pos, advancing \a pos past it
+static bool decodeReference(const QChar *&pos, const QChar *end, uint &codePoint)
+{
+    const QChar *p = pos;
+    if (*p == '#') {
+        ++p;
+        int base = 10;
+        if (p < end && (*p == 'x' || *p == 'X')) {
+            base = 16;
+            ++p;
+        }
+        const QChar *digits = p;
+        codePoint = 0;
+        for (; p < end && p - digits < 8; ++p) {
+            ushort c = p->unicode();
+            uint digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (base == 16 && c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (base == 16 && c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                break;
+            }
+            codePoint = codePoint * base + digit;
+        }
+        if (p == digits || p == end || *p != ';' || !isPlainCodePoint(codePoint)) {
+            return false;
+        }
+        pos = p + 1;
+        return true;
+    }
+
+    static const struct {
+        QLatin1String name;
+        uint codePoint;
+    } kNamedReferences[] = {
+        {QLatin1String("amp;"), '&'},
+        {QLatin1String("lt;"), '<'},
+        {QLatin1String("gt;"), '>'},
+        {QLatin1String("quot;"), '"'},
+        {QLatin1String("apos;"), '\''},
+        {QLatin1String("nbsp;"), 0xa0},
+    };
+    QStringView rest(p, end - p);
+    for (const auto &reference : kNamedReferences) {
+        if (rest.startsWith(reference.name)) {
+            codePoint = reference.codePoint;
+            pos = p + reference.name.size();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FragmentParser::decodeText(const QString &html, QString &text)
+{
+    const QChar *begin = html.constData();
+    const QChar *end = begin + html.size();
+    const QChar *run = begin;
+    bool decoded = false;
+    for (const QChar *p = begin; p < end; ++p) {
+        ushort c = p->unicode();
+        if (c == '<' || c == '\r' || c == 0) {
+            return false;
+        }
+        if (c != '&') {
+            continue;
+        }
+        if (!decoded) {
+            text.clear();
+            text.reserve(html.size());
+            decoded = true;
+        }
+        text.append(run, int(p - run));
+        const QChar *next = p + 1;
+        if (next == end || *next == ' ' || *next == '\t' || *next == '\n' || *next == '\f' || *next == '&') {
+            // not a character reference
+            text += QLatin1Char('&');
+            run = next;
+            continue;
+        }
+        uint codePoint;
+        if (!decodeReference(next, end, codePoint)) {
+            return false;
+        }
+        if (QChar::requiresSurrogates(codePoint)) {
+            text += QChar(QChar::highSurrogate(codePoint));
+            text += QChar(QChar::lowSurrogate(codePoint));
+        } else {
+            text += QChar(codePoint);
+        }
+        run = next;
+        p = next - 1;
+    }
+    if (!decoded) {
+        text = html;
+    } else {
+        text.append(run, int(end - run));
+    }
+    return true;
+}
+
+struct FragmentParser::PrivData {
+    QByteArray utf8;
+    Arena arena;
+    bool parsing{false};
+};
+
+FragmentParser::FragmentParser()
+    : d{std::make_unique<PrivData>()}
+{
+    Q_UNUSED(gumboAllocatorInstalled);
+    d->utf8.reserve(kInitialUtf8Bytes);
+}
+
+FragmentParser::~FragmentParser() = default;
+
+FragmentParser &FragmentParser::forCurrentThread()
+{
+    static thread_local FragmentParser parser;
+    return parser;
+}
+
+void FragmentParser::parseInto(Node *node, const QString &html, GumboTag context)
+{
+    if (html.isEmpty()) {
+        return;
+    }
+    QString text;
+    if (isFlowContext(context) && decodeText(html, text)) {
+        auto *textNode = new Text();
+        textNode->appendTextContent(text, html);
+        node->appendChild(textNode);
+        return;
+    }
+
+    if (d->parsing) {
+        // the buffers are in use further up the stack, and the arena is reset there
+        DomBuilder builder(html, context);
+        builder.setFreedWithArena();
+        builder.buildIntoNode(node);
+        return;
+    }
+    QScopedValueRollback<bool> parsing(d->parsing, true);
+    encodeUtf8(html, d->utf8);
+    {
+        ArenaScope scope(d->arena);
+        DomBuilder builder(d->utf8, context);
+        builder.setFreedWithArena();
+        builder.buildIntoNode(node);
+    }
+    if (d->utf8.capacity() > kRetainedUtf8Bytes) {
+        d->utf8 = QByteArray();
+        d->utf8.reserve(kInitialUtf8Bytes);
+    }
+}
+
+QString FragmentParser::textContent(const QString &html)
+{
+    QString text;
+    if (decodeText(html, text)) {
+        return text;
+    }
+    Element body(GUMBO_TAG_BODY);
+    parseInto(&body, html, GUMBO_TAG_BODY);
+    return body.textContent();
+}
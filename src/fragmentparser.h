@@ -0,0 +1,68 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include "gumbo/gumbo.h"
+#include <QByteArray>
+#include <QString>
+#include <memory>
+
+namespace QReadable {
+namespace DomSupport {
+class Node;
+}
+
+/**
+ * Parses the HTML fragments assigned to innerHTML, reusing its buffers
+ *
+ * Readability.js sets innerHTML and reads the text of Text nodes many
+ * times per page, and each parse used to transcode the fragment into a
+ * fresh UTF-8 buffer and make hundreds of small allocations for Gumbo's
+ * parse tree.  A FragmentParser keeps its UTF-8 buffer between
+ * fragments, and gives Gumbo an arena that is reset, not freed, after
+ * each one.  Markup-free text with only simple character references
+ * skips Gumbo entirely.
+ *
+ * There is one FragmentParser per thread; a DOM is only ever used from
+ * one thread at a time.
+ */
+class FragmentParser
+{
+public:
+    FragmentParser();
+    ~FragmentParser();
+    FragmentParser(const FragmentParser &) = delete;
+    FragmentParser &operator=(const FragmentParser &) = delete;
+
+    /**
+     * The FragmentParser for the calling thread
+     */
+    static FragmentParser &forCurrentThread();
+
+    /**
+     * Parse \a html as if it were the contents of a \a context element,
+     * and append the resulting nodes to \a node
+     */
+    void parseInto(DomSupport::Node *node, const QString &html, GumboTag context);
+
+    /**
+     * The text that \a html, parsed in a body element, contains
+     */
+    QString textContent(const QString &html);
+
+    /**
+     * Decode \a html into \a text without a full parse, if it is plain text
+     *
+     * Returns false, leaving \a text unspecified, if \a html has markup,
+     * characters the tokenizer rewrites, or character references other
+     * than numeric ones and &amp; &lt; &gt; &quot; &apos; and &nbsp;.
+     */
+    static bool decodeText(const QString &html, QString &text);
+
+private:
+    struct PrivData;
+    std::unique_ptr<PrivData> d;
+};
+}
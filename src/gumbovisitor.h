@@ -8,17 +8,65 @@
 #include <QString>
 
 namespace QReadable {
-class GumboVisitor
+/**
+ * A Gumbo parse tree, and the UTF-8 data it points into
+ */
+class GumboTree
+{
+public:
+    explicit GumboTree(const QString &input);
+    explicit GumboTree(const QByteArray &utf8data);
+    GumboTree(const QString &input, GumboTag fragmentContext);
+    GumboTree(const QByteArray &utf8data, GumboTag fragmentContext);
+    explicit GumboTree(GumboOutput *gumbo, const QByteArray &utf8data=QByteArray());
+    ~GumboTree();
+    GumboTree(GumboTree &other) = delete;
+    void operator=(GumboTree &other) = delete;
+
+    /**
+     * The root node of the parse tree.
+     */
+    GumboNode *const &root()
+    {
+        return m_root;
+    }
+
+    /**
+     * The UTF-8 data being parsed.  GumboStringPieces in the parse tree point into it.
+     */
+    const QByteArray &data() const
+    {
+        return m_data;
+    }
+
+    /**
+     * Leave the parse tree to be released with the arena it was allocated from,
+     * instead of freeing it node by node on destruction
+     */
+    void setFreedWithArena()
+    {
+        m_freedWithArena = true;
+    }
+
+private:
+    const QByteArray m_data;
+    GumboOutput *m_gumbo;
+    GumboNode *m_root;
+    bool m_freedWithArena{false};
+};
+
+/**
+ * Walks a Gumbo parse tree, calling back \a Derived for each node
+ *
+ * \a Derived hides whichever of visitElementOpen(), visitText() and
+ * visitElementClose() it needs.  The callbacks are resolved at compile
+ * time and inlined into walk().
+ */
+template<typename Derived>
+class GumboVisitor : public GumboTree
 {
 public:
-    explicit GumboVisitor(const QString &input);
-    explicit GumboVisitor(const QByteArray &utf8data);
-    GumboVisitor(const QString &input, GumboTag fragmentContext);
-    GumboVisitor(const QByteArray &utf8data, GumboTag fragmentContext);
-    explicit GumboVisitor(GumboOutput *gumbo, const QByteArray &utf8data=QByteArray());
-    virtual ~GumboVisitor();
-    GumboVisitor(GumboVisitor &other) = delete;
-    void operator=(GumboVisitor &other) = delete;
+    using GumboTree::GumboTree;
 
     /**
      * Walk the element tree.
@@ -27,24 +75,81 @@ public:
      */
     void walk();
 
+protected:
     /**
-     * The root node of the parse tree.
+     * Stop walking the tree once the current visit* method returns.
      */
-    GumboNode *const &root()
+    void stopWalk()
     {
-        return m_root;
+        m_stopped = true;
     }
 
+    void visitElementOpen(GumboNode *) {}
+    void visitText(GumboNode *) {}
+    void visitElementClose(GumboNode *) {}
+
 private:
-    virtual void visitElementOpen(GumboNode *node){};
-    virtual void visitText(GumboNode *node){};
-    virtual void visitElementClose(GumboNode *node){};
-    virtual void finished(){};
+    bool m_stopped{false};
 
-    const QByteArray m_data;
-    GumboOutput *m_gumbo;
-    GumboNode *m_root;
-    GumboNode *m_node;
-    void moveNext();
+    Derived &derived()
+    {
+        return static_cast<Derived &>(*this);
+    }
 };
+
+template<typename Derived>
+void GumboVisitor<Derived>::walk()
+{
+    void *const top = root();
+    if (!top) {
+        return;
+    }
+    // the current node is siblings[index]; they are only looked up again on the way back up
+    void *const *siblings = &top;
+    unsigned int count = 1;
+    unsigned int index = 0;
+    while (!m_stopped) {
+        auto *node = static_cast<GumboNode *>(siblings[index]);
+        switch (node->type) {
+        case GUMBO_NODE_TEXT:
+        case GUMBO_NODE_CDATA:
+        case GUMBO_NODE_WHITESPACE:
+            derived().visitText(node);
+            break;
+        case GUMBO_NODE_ELEMENT: {
+            derived().visitElementOpen(node);
+            if (m_stopped) {
+                return;
+            }
+            const GumboVector &children = node->v.element.children;
+            if (children.length > 0) {
+                siblings = children.data;
+                count = children.length;
+                index = 0;
+                continue;
+            }
+            derived().visitElementClose(node);
+            break;
+        }
+        default:
+            break;
+        }
+
+        // move on to the next sibling, closing each parent that has none left
+        while (++index == count) {
+            if (node == top || m_stopped) {
+                return;
+            }
+            node = node->parent;
+            derived().visitElementClose(node);
+            if (node == top) {
+                return;
+            }
+            const GumboVector &parentSiblings = node->parent->v.element.children;
+            siblings = parentSiblings.data;
+            count = parentSiblings.length;
+            index = node->index_within_parent;
+        }
+    }
+}
 }
@@ -3,38 +3,392 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QSocketNotifier>
 #include <QTextStream>
+#include <QThread>
+#include <csignal>
 #include <cstdio>
+#include <mutex>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "extractionserver.h"
+#include "fetcher.h"
 #include "readable.h"
+#include "resultcache.h"
+#include "warcreader.h"
+#include "workerpool.h"
 
 
 using namespace QReadable;
-int main(int argc, char **argv)
+
+namespace {
+/**
+ * Writes JSON records to stdout, one per line, from any thread
+ */
+class JsonLineWriter
 {
-    Q_INIT_RESOURCE(readability);
-    QCoreApplication app(argc, argv);
+public:
+    JsonLineWriter()
+    {
+        m_out.open(stdout, QFile::WriteOnly);
+    }
+
+    void write(const QJsonObject &record)
+    {
+        QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+        line += '\n';
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_out.write(line);
+    }
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_out.flush();
+    }
+
+private:
+    std::mutex m_mutex;
+    QFile m_out;
+};
+}
+
+static void printCacheStats(const ResultCache *cache)
+{
+    if (!cache) {
+        return;
+    }
+    ResultCache::Stats stats = cache->stats();
+    qInfo().nospace() << "Cache: " << stats.memoryHits << " memory hits, " << stats.diskHits << " disk hits, "
+                      << stats.misses << " misses, " << stats.memoryEvictions << " evictions";
+}
+
+static void printNativeCallReport(const NativeCallTable &calls)
+{
+    QTextStream(stderr) << nativeCallReport(calls);
+}
+
+static int runBatch(const QStringList &paths, const QString &manifest, int jobs, const ReadableOptions &options, std::shared_ptr<ResultCache> cache, bool profileDom)
+{
+    JsonLineWriter writer;
+    WorkerPool pool(jobs, options, [&writer](const QJsonObject &record){
+        writer.write(record);
+    }, cache);
+    pool.setProfileNativeCalls(profileDom);
+
+    auto submitPath = [&pool](const QString &path) {
+        ExtractionJob job;
+        job.source = ExtractionJob::Source::File;
+        job.path = path;
+        job.url = QUrl::fromLocalFile(path);
+        pool.submit(std::move(job));
+    };
 
-    auto urlString = QCoreApplication::arguments().value(1);
-    auto url = QUrl(urlString);
+    for (const QString &path : paths) {
+        submitPath(path);
+    }
+
+    if (!manifest.isEmpty()) {
+        QFile manifestFile;
+        bool opened;
+        if (manifest == QLatin1String("-")) {
+            opened = manifestFile.open(stdin, QFile::ReadOnly);
+        } else {
+            manifestFile.setFileName(manifest);
+            opened = manifestFile.open(QFile::ReadOnly);
+        }
+        if (!opened) {
+            qWarning() << "Failed to open manifest:" << manifestFile.errorString();
+            pool.finish();
+            return 1;
+        }
+        while (!manifestFile.atEnd()) {
+            QString path = QString::fromUtf8(manifestFile.readLine()).trimmed();
+            if (!path.isEmpty()) {
+                submitPath(path);
+            }
+        }
+    }
+
+    pool.finish();
+    writer.flush();
+    printCacheStats(cache.get());
+    if (profileDom) {
+        printNativeCallReport(pool.nativeCallProfile());
+    }
+    return 0;
+}
+
+static int runWarc(const QStringList &paths, int jobs, const ReadableOptions &options, std::shared_ptr<ResultCache> cache, bool profileDom)
+{
+    JsonLineWriter writer;
+    WorkerPool pool(jobs, options, [&writer](const QJsonObject &record){
+        writer.write(record);
+    }, cache);
+    pool.setProfileNativeCalls(profileDom);
+
+    int result = 0;
+    for (const QString &path : paths) {
+        QFile file;
+        bool opened;
+        if (path == QLatin1String("-")) {
+            opened = file.open(stdin, QFile::ReadOnly);
+        } else {
+            file.setFileName(path);
+            opened = file.open(QFile::ReadOnly);
+        }
+        if (!opened) {
+            qWarning() << "Failed to open WARC file:" << path << file.errorString();
+            result = 1;
+            continue;
+        }
+
+        WarcReader reader(&file);
+        WarcRecord record;
+        while (reader.readRecord(record)) {
+            if (record.header("WARC-Type") != "response") {
+                continue;
+            }
+            QByteArray contentType;
+            ExtractionJob job;
+            if (!WarcReader::parseHttpResponse(record.block, contentType, job.html) || !isHtmlContentType(contentType)) {
+                continue;
+            }
+            QByteArray targetUri = record.header("WARC-Target-URI");
+            QByteArray digest = record.header("WARC-Payload-Digest");
+            if (digest.isEmpty()) {
+                digest = record.header("WARC-Block-Digest");
+            }
+            job.url = QUrl::fromEncoded(targetUri);
+            job.fields.insert("warcFile", path);
+            job.fields.insert("warcRecordId", QString::fromUtf8(record.header("WARC-Record-ID")));
+            job.fields.insert("warcTargetUri", QString::fromUtf8(targetUri));
+            job.fields.insert("warcDigest", QString::fromUtf8(digest));
+            pool.submit(std::move(job));
+        }
+        if (!reader.errorString().isEmpty()) {
+            qWarning() << "Error reading WARC file:" << path << reader.errorString();
+            result = 1;
+        }
+    }
+
+    pool.finish();
+    writer.flush();
+    printCacheStats(cache.get());
+    if (profileDom) {
+        printNativeCallReport(pool.nativeCallProfile());
+    }
+    return result;
+}
+
+static int runFetch(QCoreApplication &app, const QString &list, int jobs, const ReadableOptions &options, std::shared_ptr<ResultCache> cache, const FetchOptions &fetchOptions, bool profileDom)
+{
+    QFile listFile;
+    bool opened;
+    if (list == QLatin1String("-")) {
+        opened = listFile.open(stdin, QFile::ReadOnly);
+    } else {
+        listFile.setFileName(list);
+        opened = listFile.open(QFile::ReadOnly);
+    }
+    if (!opened) {
+        qWarning() << "Failed to open URL list:" << listFile.errorString();
+        return 1;
+    }
 
+    JsonLineWriter writer;
+    auto handler = [&writer](const QJsonObject &record){
+        writer.write(record);
+    };
+    WorkerPool pool(jobs, options, handler, cache);
+    pool.setProfileNativeCalls(profileDom);
+    Fetcher fetcher(&pool, fetchOptions, handler);
+    QObject::connect(&fetcher, &Fetcher::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+    while (!listFile.atEnd()) {
+        QString line = QString::fromUtf8(listFile.readLine()).trimmed();
+        if (!line.isEmpty()) {
+            fetcher.add(QUrl(line));
+        }
+    }
+    fetcher.finishAdding();
+    int result = QCoreApplication::exec();
+
+    pool.finish();
+    writer.flush();
+    printCacheStats(cache.get());
+    if (profileDom) {
+        printNativeCallReport(pool.nativeCallProfile());
+    }
+    return result;
+}
+
+// signal handlers write to one end, and the event loop reads the other
+static int drainSignalFds[2];
+
+static void handleDrainSignal(int)
+{
+    char signalled = 1;
+    (void)::write(drainSignalFds[0], &signalled, sizeof(signalled));
+}
+
+static int runServer(QCoreApplication &app, const QString &socketPath, const QString &port, int jobs, const ReadableOptions &options, std::shared_ptr<ResultCache> cache)
+{
+    ExtractionServer server(jobs, options, cache);
+    if (!socketPath.isEmpty() && !server.listenLocal(socketPath)) {
+        qWarning() << "Failed to listen on" << socketPath << server.errorString();
+        return 1;
+    }
+    if (!port.isEmpty() && !server.listenTcp(port.toUShort())) {
+        qWarning() << "Failed to listen on port" << port << server.errorString();
+        return 1;
+    }
+
+    // SIGTERM and SIGINT finish the requests in progress and exit
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, drainSignalFds) != 0) {
+        qWarning() << "Failed to create signal socket";
+        return 1;
+    }
+    QSocketNotifier drainNotifier(drainSignalFds[1], QSocketNotifier::Read);
+    QObject::connect(&drainNotifier, &QSocketNotifier::activated, &server, [&drainNotifier, &server]{
+        char signalled;
+        (void)::read(drainSignalFds[1], &signalled, sizeof(signalled));
+        drainNotifier.setEnabled(false);
+        server.drain();
+    });
+    struct sigaction action = {};
+    action.sa_handler = handleDrainSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    QObject::connect(&server, &ExtractionServer::drained, &app, &QCoreApplication::quit);
+    return QCoreApplication::exec();
+}
+
+static int printFile(const QUrl &url, const ReadableOptions &options, bool profileDom)
+{
+    Readable readable(options);
+    readable.setProfileNativeCalls(profileDom);
+    Article article = readable.parseFile(url.toLocalFile(), url);
+    if (article.status() == Article::ReadError) {
+        qWarning() << "Failed to read file:" << url.toLocalFile();
+        return 1;
+    }
+    QTextStream(stdout) << article.content();
+    if (profileDom) {
+        printNativeCallReport(readable.lastParseStats().nativeCalls);
+    }
+    return 0;
+}
+
+static int fetchAndPrint(QCoreApplication &app, const QUrl &url, const ReadableOptions &options, bool profileDom)
+{
     QNetworkAccessManager nam;
     QNetworkRequest req(url);
     req.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
     QNetworkReply *reply = nam.get(req);
-    QObject::connect(reply, &QNetworkReply::finished, &app, [reply]{
+    QObject::connect(reply, &QNetworkReply::finished, &app, [reply, &options, profileDom]{
         if (reply->error()!=QNetworkReply::NoError) {
             qWarning() << "Failed to load content: " << reply->errorString();
             QCoreApplication::exit(1);
+            return;
         }
         QByteArray data = reply->readAll();
         QString text(data);
-        Readable readable;
-        QTextStream(stdout) << readable.parse(text, reply->url());
+        Readable readable(options);
+        readable.setProfileNativeCalls(profileDom);
+        QTextStream(stdout) << readable.parse(text, reply->url()).content();
+        if (profileDom) {
+            printNativeCallReport(readable.lastParseStats().nativeCalls);
+        }
         QCoreApplication::quit();
     });
 
-    QCoreApplication::exec();
+    return QCoreApplication::exec();
+}
+
+int main(int argc, char **argv)
+{
+    Q_INIT_RESOURCE(readability);
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Extracts the readable content of web pages.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("url", "The page to fetch (a file:// URL is read directly), or with --batch or --warc, the files to process.", "<url>|<files...>");
+    QCommandLineOption batchOption("batch", "Process local HTML files and write one JSON record per line to stdout.");
+    QCommandLineOption manifestOption("manifest", "With --batch, also process the files listed in <file>, one per line (- for stdin).", "file");
+    QCommandLineOption warcOption("warc", "Process the HTML responses in WARC files (optionally gzipped, - for stdin) and write one JSON record per line to stdout.");
+    QCommandLineOption fetchOption("fetch", "Download and process the URLs listed in <file>, one per line (- for stdin), and write one JSON record per line to stdout.", "file");
+    QCommandLineOption httpCacheOption("http-cache", "With --fetch, cache HTTP responses in <dir> and revalidate them on later runs.", "dir");
+    QCommandLineOption maxConnectionsOption("max-connections", "With --fetch, the most downloads to run at once.", "n", "16");
+    QCommandLineOption maxPerHostOption("max-per-host", "With --fetch, the most downloads to run at once from one host.", "n", "4");
+    QCommandLineOption listenOption("listen", "Serve extraction requests on the Unix domain socket <path>.", "path");
+    QCommandLineOption portOption("port", "Serve extraction requests on <port> on the loopback interface.", "port");
+    QCommandLineOption jobsOption({"j", "jobs"}, "With --batch, --warc, --fetch, --listen or --port, the number of worker engines to run.", "n", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption formatOption("format", "The content format: html, text or markdown.", "format", "html");
+    QCommandLineOption cacheOption("cache", "With --batch, --warc, --fetch, --listen or --port, cache results in memory and in <file>.", "file");
+    QCommandLineOption cacheSizeOption("cache-size", "The most results to keep in the cache file, in megabytes.", "mb", "1024");
+    QCommandLineOption profileDomOption("profile-dom", "Profile the calls Readability.js makes into the DOM, and print a report to stderr after the page, or with --batch, --warc or --fetch, after all of them.");
+    parser.addOptions({batchOption, manifestOption, warcOption, fetchOption, httpCacheOption, maxConnectionsOption, maxPerHostOption, listenOption, portOption, jobsOption, formatOption, cacheOption, cacheSizeOption, profileDomOption});
+    parser.process(app);
+
+    ReadableOptions options;
+    if (!parseOutputFormat(parser.value(formatOption), options.outputFormat)) {
+        qWarning() << "Unknown format:" << parser.value(formatOption);
+        return 1;
+    }
+
+    std::shared_ptr<ResultCache> cache;
+    if (parser.isSet(cacheOption)) {
+        cache = std::make_shared<ResultCache>();
+        if (!cache->setDiskStore(parser.value(cacheOption), parser.value(cacheSizeOption).toLongLong() * 1024 * 1024)) {
+            qWarning() << "Failed to open cache file:" << parser.value(cacheOption);
+            return 1;
+        }
+    }
+
+    bool profileDom = parser.isSet(profileDomOption);
+    if (parser.isSet(listenOption) || parser.isSet(portOption)) {
+        return runServer(app, parser.value(listenOption), parser.value(portOption), parser.value(jobsOption).toInt(), options, cache);
+    }
+
+    if (parser.isSet(fetchOption)) {
+        FetchOptions fetchOptions;
+        fetchOptions.cacheDirectory = parser.value(httpCacheOption);
+        fetchOptions.maxConcurrent = qMax(1, parser.value(maxConnectionsOption).toInt());
+        fetchOptions.maxPerHost = qMax(1, parser.value(maxPerHostOption).toInt());
+        return runFetch(app, parser.value(fetchOption), parser.value(jobsOption).toInt(), options, cache, fetchOptions, profileDom);
+    }
+
+    if (parser.isSet(warcOption)) {
+        if (parser.positionalArguments().isEmpty()) {
+            parser.showHelp(1);
+        }
+        return runWarc(parser.positionalArguments(), parser.value(jobsOption).toInt(), options, cache, profileDom);
+    }
+
+    if (parser.isSet(batchOption)) {
+        if (parser.positionalArguments().isEmpty() && !parser.isSet(manifestOption)) {
+            parser.showHelp(1);
+        }
+        return runBatch(parser.positionalArguments(), parser.value(manifestOption), parser.value(jobsOption).toInt(), options, cache, profileDom);
+    }
+
+    if (parser.positionalArguments().length() != 1) {
+        parser.showHelp(1);
+    }
+    QUrl url(parser.positionalArguments().first());
+    if (url.isLocalFile()) {
+        return printFile(url, options, profileDom);
+    }
+    return fetchAndPrint(app, url, options, profileDom);
 }
@@ -0,0 +1,51 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QtGlobal>
+#include <chrono>
+#include <memory>
+#include "readable-defs.h"
+
+namespace QReadable {
+/**
+ * Resource budgets for a single call to Readable::parse()
+ *
+ * A value of zero means "no limit".
+ */
+struct ParseLimits {
+    /** Wall-clock budget for the whole parse, including DOM building and script execution */
+    std::chrono::milliseconds timeout{0};
+
+    /** Stop building the DOM rather than create more than this many nodes */
+    int maxNodes{0};
+
+    /** Only parse the first maxBytes bytes of UTF-8 input */
+    qint64 maxBytes{0};
+};
+
+/**
+ * Cooperative cancellation for Readable::parse()
+ *
+ * Copies of a token share the same state, so a token can be handed to
+ * one or more parse() calls and cancelled from any thread.  A parse
+ * that observes the cancellation stops building the DOM or interrupts
+ * the script engine, and returns an Article with the Cancelled status.
+ */
+class QREADABLE_EXPORT CancellationToken
+{
+public:
+    CancellationToken();
+    ~CancellationToken();
+
+    void cancel();
+    bool isCancelled() const;
+
+private:
+    struct State;
+    std::shared_ptr<State> d;
+    friend class Watchdog;
+};
+}
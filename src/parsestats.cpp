@@ -0,0 +1,109 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "parsestats.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <algorithm>
+using namespace QReadable;
+
+qint64 ParseStats::phaseNs(const QString &name) const
+{
+    for (const Phase &eachPhase : phases) {
+        if (eachPhase.name == name) {
+            return eachPhase.durationNs;
+        }
+    }
+    return 0;
+}
+
+// trace event timestamps are in (fractional) microseconds
+static QJsonObject traceEvent(const QString &name, qint64 startNs, qint64 durationNs)
+{
+    return QJsonObject{
+        {"name", name},
+        {"cat", "qreadable"},
+        {"ph", "X"},
+        {"ts", startNs / 1000.0},
+        {"dur", durationNs / 1000.0},
+        {"pid", 1},
+        {"tid", 1}};
+}
+
+QByteArray ParseStats::toChromeTrace() const
+{
+    QJsonObject calls;
+    for (auto it = nativeCalls.cbegin(); it != nativeCalls.cend(); ++it) {
+        calls.insert(it.key(), QJsonObject{
+                         {"count", it.value().count},
+                         {"ms", it.value().totalNs / 1e6},
+                         {"bytes", it.value().bytes}});
+    }
+
+    QJsonObject parse = traceEvent("parse", 0, totalNs);
+    parse.insert("args", QJsonObject{
+                     {"fromCache", fromCache},
+                     {"inputBytes", inputBytes},
+                     {"nodesBuilt", nodesBuilt},
+                     {"elementsRemoved", elementsRemoved},
+                     {"grabArticleAttempts", grabArticleAttempts},
+                     {"outputSize", outputSize},
+                     {"nativeCalls", calls}});
+
+    QJsonArray events{parse};
+    for (const Phase &eachPhase : phases) {
+        events.append(traceEvent(eachPhase.name, eachPhase.startNs, eachPhase.durationNs));
+    }
+    return QJsonDocument(QJsonObject{
+                             {"traceEvents", events},
+                             {"displayTimeUnit", "ms"}}).toJson(QJsonDocument::Compact);
+}
+
+QString QReadable::nativeCallReport(const NativeCallTable &calls)
+{
+    QVector<NativeCallTable::const_iterator> rows;
+    int nameWidth = 6;
+    for (auto it = calls.cbegin(); it != calls.cend(); ++it) {
+        rows.append(it);
+        nameWidth = qMax(nameWidth, it.key().size());
+    }
+    std::sort(rows.begin(), rows.end(), [](NativeCallTable::const_iterator a, NativeCallTable::const_iterator b) {
+        if (a.value().totalNs != b.value().totalNs) {
+            return a.value().totalNs > b.value().totalNs;
+        }
+        if (a.value().count != b.value().count) {
+            return a.value().count > b.value().count;
+        }
+        return a.key() < b.key();
+    });
+
+    QString report;
+    QTextStream out(&report);
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(2);
+    auto name = [&out, nameWidth](const QString &text) {
+        out.setFieldAlignment(QTextStream::AlignLeft);
+        out.setFieldWidth(nameWidth);
+        out << text;
+        out.setFieldAlignment(QTextStream::AlignRight);
+        out.setFieldWidth(12);
+    };
+    auto endRow = [&out] {
+        out.setFieldWidth(0);
+        out << '\n';
+    };
+    name(QStringLiteral("member"));
+    out << "calls" << "total ms" << "ns/call" << "KiB";
+    endRow();
+    for (auto it : qAsConst(rows)) {
+        const NativeCallStats &call = it.value();
+        name(it.key());
+        out << call.count << call.totalNs / 1e6 << call.totalNs / qMax(1, call.count) << call.bytes / 1024.0;
+        endRow();
+    }
+    out.flush();
+    return report;
+}
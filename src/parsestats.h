@@ -0,0 +1,106 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "readable-defs.h"
+
+namespace QReadable {
+/**
+ * Calls from Readability.js to one native DOM property or method
+ *
+ * totalNs and bytes are only measured when profiling native calls
+ * (see Readable::setProfileNativeCalls()).  totalNs is the time spent in
+ * the native code, and bytes approximates the size of the arguments and
+ * results that had to be converted between script and C++.
+ */
+struct NativeCallStats {
+    int count{0};
+    qint64 totalNs{0};
+    qint64 bytes{0};
+
+    NativeCallStats &operator+=(const NativeCallStats &other)
+    {
+        count += other.count;
+        totalNs += other.totalNs;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+/**
+ * Native calls by "Class.member"; setters are named "Class.member="
+ */
+using NativeCallTable = QHash<QString, NativeCallStats>;
+
+/**
+ * A plain text table of \a calls, the most expensive first
+ */
+QREADABLE_EXPORT QString nativeCallReport(const NativeCallTable &calls);
+
+/**
+ * Where the time went in one call to Readable::parse()
+ *
+ * Stats are only collected when enabled with Readable::setCollectStats().
+ */
+struct QREADABLE_EXPORT ParseStats {
+    struct Phase {
+        QString name;
+        qint64 startNs{0};      ///< from the start of the parse
+        qint64 durationNs{0};
+    };
+
+    /**
+     * The phases of the parse, in order
+     *
+     * These are "gumboParse", "domBuild", "extraction" (running
+     * Readability.js) and "serialization" (producing the article content).
+     * Phases that didn't run, because the parse stopped early or the result
+     * came from the cache, are missing.
+     */
+    QVector<Phase> phases;
+
+    /** Wall-clock time of the whole parse */
+    qint64 totalNs{0};
+
+    /** True if the result came from the ResultCache */
+    bool fromCache{false};
+
+    /** Bytes of UTF-8 HTML parsed, after any ParseLimits::maxBytes truncation */
+    qint64 inputBytes{0};
+
+    /** DOM nodes built from the HTML */
+    int nodesBuilt{0};
+
+    /** Elements removed from the DOM by Readability.js */
+    int elementsRemoved{0};
+
+    /** Passes made by Readability.js's _grabArticle(), which retries with fewer heuristics when it finds too little text */
+    int grabArticleAttempts{0};
+
+    /** Calls from Readability.js into the native DOM */
+    NativeCallTable nativeCalls;
+
+    /** UTF-16 code units in the article content */
+    qint64 outputSize{0};
+
+    /**
+     * The duration of the phase called \a name, or zero if it didn't run
+     */
+    qint64 phaseNs(const QString &name) const;
+
+    /**
+     * These stats in Chrome's trace event format
+     *
+     * Each phase is a complete ("X") event on a single track, and the
+     * counters are attached to an enclosing "parse" event.  The result can
+     * be loaded into chrome://tracing or Perfetto.
+     */
+    QByteArray toChromeTrace() const;
+};
+}
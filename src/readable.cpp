@@ -3,43 +3,457 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include "readable.h"
+#include <QFile>
+#include <QElapsedTimer>
 #include <QQmlEngine>
+#include <limits>
 #include "dombuilder.h"
 #include "jshelpers.h"
+#include "readerable.h"
+#include "resultcache.h"
+#include "statscollector.h"
+#include "textserializer.h"
+#include "watchdog.h"
 using namespace QReadable;
 
+namespace {
+// Arms a parse's watchdog, and disarms it again on every way out of the parse
+class WatchdogArming
+{
+public:
+    WatchdogArming() = default;
+    ~WatchdogArming()
+    {
+        if (m_watchdog) {
+            m_watchdog->disarm();
+        }
+    }
+    WatchdogArming(const WatchdogArming &) = delete;
+    WatchdogArming &operator=(const WatchdogArming &) = delete;
+
+    void arm(Watchdog *watchdog, const CancellationToken &token, Watchdog::Clock::time_point deadline)
+    {
+        watchdog->arm(token, deadline);
+        m_watchdog = watchdog;
+    }
+
+    // the armed watchdog, or null if the parse has none
+    Watchdog *watchdog() const
+    {
+        return m_watchdog;
+    }
+
+private:
+    Watchdog *m_watchdog{nullptr};
+};
+}
+
 struct Readable::PrivData {
     QQmlEngine engine;
+    ReadableOptions options;
+    QJSValue jsOptions;
+    ReadableOptions lastCallOptions;
+    QJSValue lastCallJsOptions;
+    QJSValue nodeSerializer;
+    std::shared_ptr<ResultCache> cache;
+    bool collectStats{false};
+    bool profileNativeCalls{false};
+    ParseStats lastStats;
+    // one thread per Readable, armed for each parse with a token or timeout
+    std::unique_ptr<Watchdog> persistentWatchdog;
+    QJSValue toJSValue(const ReadableOptions &options);
+    QJSValue jsOptionsFor(const ReadableOptions &callOptions);
+    Article parse(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken *token, std::shared_ptr<const void> sourceOwner=nullptr);
+    Article parseFile(const QString &path, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken *token);
 };
 
+QJSValue Readable::PrivData::toJSValue(const ReadableOptions &options)
+{
+    QJSValue result = engine.newObject();
+    result.setProperty("maxElemsToParse", options.maxElemsToParse);
+    result.setProperty("nbTopCandidates", options.nbTopCandidates);
+    result.setProperty("charThreshold", options.charThreshold);
+    result.setProperty("keepClasses", options.keepClasses);
+    result.setProperty("disableJSONLD", options.disableJSONLD);
+    QJSValue classesToPreserve = engine.newArray(options.classesToPreserve.length());
+    for (int i=0; i<options.classesToPreserve.length(); i++) {
+        classesToPreserve.setProperty(i, options.classesToPreserve.at(i));
+    }
+    result.setProperty("classesToPreserve", classesToPreserve);
+    if (options.outputFormat != OutputFormat::Html || collectStats) {
+        // hand the article node back to C++ instead of serializing it
+        if (nodeSerializer.isUndefined()) {
+            nodeSerializer = engine.evaluate("(function(el) { return el; })");
+        }
+        result.setProperty("serializer", nodeSerializer);
+    }
+    return result;
+}
+
+// The options object is only read by the Readability constructor, so the
+// marshalled options can be reused for every call with the same options.
+QJSValue Readable::PrivData::jsOptionsFor(const ReadableOptions &callOptions)
+{
+    if (callOptions == options) {
+        return jsOptions;
+    }
+    if (lastCallJsOptions.isUndefined() || callOptions != lastCallOptions) {
+        lastCallOptions = callOptions;
+        lastCallJsOptions = toJSValue(callOptions);
+    }
+    return lastCallJsOptions;
+}
+
+// Truncate UTF-8 data to at most maxBytes without splitting a code point.
+// The result refers to utf8data's storage instead of copying it.
+static QByteArray truncateUtf8(const QByteArray &utf8data, qint64 maxBytes)
+{
+    int length = static_cast<int>(maxBytes);
+    while (length > 0 && (static_cast<uchar>(utf8data.at(length)) & 0xC0) == 0x80) {
+        --length;
+    }
+    return QByteArray::fromRawData(utf8data.constData(), length);
+}
+
+namespace {
+/**
+ * Records the phases of a parse into stats, if there are any
+ */
+class PhaseRecorder
+{
+public:
+    explicit PhaseRecorder(ParseStats *stats)
+        : m_stats(stats)
+    {
+        if (m_stats) {
+            m_timer.start();
+        }
+    }
+
+    ~PhaseRecorder()
+    {
+        if (m_stats) {
+            m_stats->totalNs = m_timer.nsecsElapsed();
+        }
+    }
+
+    void start()
+    {
+        if (m_stats) {
+            m_phaseStart = m_timer.nsecsElapsed();
+        }
+    }
+
+    void finish(const char *name)
+    {
+        if (m_stats) {
+            qint64 now = m_timer.nsecsElapsed();
+            m_stats->phases.append({QString::fromLatin1(name), m_phaseStart, now - m_phaseStart});
+        }
+    }
+
+private:
+    ParseStats *m_stats;
+    QElapsedTimer m_timer;
+    qint64 m_phaseStart{0};
+};
+}
+
 static void initResources()
 {
     Q_INIT_RESOURCE(readability);
 }
 
 Readable::Readable(QObject *parent)
+    : Readable(ReadableOptions(), parent)
+{
+}
+
+Readable::Readable(const ReadableOptions &options, QObject *parent)
     : QObject(parent)
     , d{std::make_unique<PrivData>()}
 {
     initResources();
     d->engine.installExtensions(QJSEngine::ConsoleExtension);
     JSHelpers::evalFile(d->engine, ":/Readability.js");
+    setOptions(options);
+}
+
+ReadableOptions Readable::options() const
+{
+    return d->options;
+}
+
+void Readable::setOptions(const ReadableOptions &options)
+{
+    d->options = options;
+    d->jsOptions = d->toJSValue(options);
+}
+
+void Readable::setResultCache(std::shared_ptr<ResultCache> cache)
+{
+    d->cache = std::move(cache);
+}
+
+std::shared_ptr<ResultCache> Readable::resultCache() const
+{
+    return d->cache;
+}
+
+void Readable::setCollectStats(bool collect)
+{
+    if (!collect) {
+        d->profileNativeCalls = false;
+    }
+    if (collect == d->collectStats) {
+        return;
+    }
+    // the article is serialized natively while collecting, to time it separately
+    d->collectStats = collect;
+    d->jsOptions = d->toJSValue(d->options);
+    d->lastCallJsOptions = QJSValue();
+}
+
+bool Readable::collectsStats() const
+{
+    return d->collectStats;
+}
+
+void Readable::setProfileNativeCalls(bool profile)
+{
+    if (profile) {
+        setCollectStats(true);
+    }
+    d->profileNativeCalls = profile;
+}
+
+bool Readable::profilesNativeCalls() const
+{
+    return d->profileNativeCalls;
+}
+
+ParseStats Readable::lastParseStats() const
+{
+    return d->lastStats;
+}
+
+Article Readable::parse(const QString &htmlContent, const QUrl &url)
+{
+    return d->parse(htmlContent.toUtf8(), url, d->options, ParseLimits(), nullptr);
+}
+
+Article Readable::parse(const QString &htmlContent, const QUrl &url, const ReadableOptions &options)
+{
+    return d->parse(htmlContent.toUtf8(), url, options, ParseLimits(), nullptr);
+}
+
+Article Readable::parse(const QString &htmlContent, const QUrl &url, const ParseLimits &limits)
+{
+    return d->parse(htmlContent.toUtf8(), url, d->options, limits, nullptr);
+}
+
+Article Readable::parse(const QString &htmlContent, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits)
+{
+    return d->parse(htmlContent.toUtf8(), url, options, limits, nullptr);
+}
+
+Article Readable::parse(const QString &htmlContent, const QUrl &url, const ParseLimits &limits, const CancellationToken &token)
+{
+    return d->parse(htmlContent.toUtf8(), url, d->options, limits, &token);
+}
+
+Article Readable::parse(const QString &htmlContent, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken &token)
+{
+    return d->parse(htmlContent.toUtf8(), url, options, limits, &token);
+}
+
+Article Readable::parse(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits)
+{
+    return d->parse(utf8data, url, options, limits, nullptr);
+}
+
+Article Readable::parse(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken &token)
+{
+    return d->parse(utf8data, url, options, limits, &token);
+}
+
+Article Readable::parseFile(const QString &path, const QUrl &url)
+{
+    return d->parseFile(path, url, d->options, ParseLimits(), nullptr);
+}
+
+Article Readable::parseFile(const QString &path, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits)
+{
+    return d->parseFile(path, url, options, limits, nullptr);
 }
 
-QString Readable::parse(const QString &htmlContent, const QUrl &url)
+Article Readable::parseFile(const QString &path, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken &token)
 {
-    DomBuilder builder(htmlContent);
+    return d->parseFile(path, url, options, limits, &token);
+}
+
+Article Readable::PrivData::parseFile(const QString &path, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken *token)
+{
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        return Article(QJSValue(), Article::ReadError);
+    }
+    qint64 size = file->size();
+    if (limits.maxBytes > 0 && size > limits.maxBytes) {
+        // map one extra byte so truncation can see whether it splits a code point
+        size = limits.maxBytes + 1;
+    }
+    if (size == 0) {
+        return parse(QByteArray(), url, options, limits, token);
+    }
+    if (size > std::numeric_limits<int>::max()) {
+        return Article(QJSValue(), Article::ReadError);
+    }
+    const uchar *mapping = file->map(0, size);
+    if (!mapping) {
+        // not mappable (e.g. a pipe); fall back to reading it
+        QByteArray utf8data = file->read(size);
+        if (file->error() != QFileDevice::NoError) {
+            return Article(QJSValue(), Article::ReadError);
+        }
+        return parse(utf8data, url, options, limits, token);
+    }
+    // the mapping lives as long as the QFile, which the document keeps alive
+    QByteArray utf8data = QByteArray::fromRawData(reinterpret_cast<const char *>(mapping), static_cast<int>(size));
+    return parse(utf8data, url, options, limits, token, file);
+}
+
+Article Readable::PrivData::parse(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken *token, std::shared_ptr<const void> sourceOwner)
+{
+    lastStats = ParseStats();
+    ParseStats *stats = collectStats ? &lastStats : nullptr;
+    PhaseRecorder phases(stats);
+
+    if (token && token->isCancelled()) {
+        return Article(QJSValue(), Article::Cancelled);
+    }
+
+    ResultCache::Key cacheKey{};
+    if (cache) {
+        cacheKey = ResultCache::key(utf8data, url, options);
+        Article cached;
+        if (cache->lookup(cacheKey, cached)) {
+            if (stats) {
+                stats->fromCache = true;
+                stats->outputSize = cached.content().size();
+            }
+            return cached;
+        }
+    }
+
+    Article::Status status = Article::Complete;
+    QByteArray input = utf8data;
+    if (limits.maxBytes > 0 && utf8data.size() > limits.maxBytes) {
+        input = truncateUtf8(utf8data, limits.maxBytes);
+        status = Article::Truncated;
+    }
+    if (stats) {
+        stats->inputBytes = input.size();
+    }
+
+    WatchdogArming arming;
+    if (token || limits.timeout.count() > 0) {
+        auto deadline = limits.timeout.count() > 0 ?
+                    Watchdog::Clock::now() + limits.timeout :
+                    Watchdog::Clock::time_point::max();
+        if (!persistentWatchdog) {
+            persistentWatchdog = std::make_unique<Watchdog>(&engine);
+        }
+        arming.arm(persistentWatchdog.get(), token ? *token : CancellationToken(), deadline);
+    }
+    Watchdog *watchdog = arming.watchdog();
+
+    phases.start();
+    DomBuilder builder(input, sourceOwner ? sourceOwner : std::make_shared<QByteArray>(utf8data));
+    phases.finish("gumboParse");
+    if (watchdog) {
+        builder.setBudget(limits.maxNodes, [watchdog]{ return watchdog->hasFired(); });
+    } else {
+        builder.setBudget(limits.maxNodes);
+    }
+    // scripts count towards maxElemsToParse, so only leave them out when it is off
+    builder.setSkipScripts(options.maxElemsToParse == 0);
+    phases.start();
     QScopedPointer<DomSupport::Document> document(builder.buildDocument(url));
-    QJSValue jsDocument = d->engine.newQObject(document.get());
+    phases.finish("domBuild");
+    if (stats) {
+        stats->nodesBuilt = builder.nodeCount();
+    }
+    if (watchdog && watchdog->hasFired()) {
+        watchdog->disarm();
+        return Article(QJSValue(), watchdog->status());
+    }
+    if (builder.isTruncated()) {
+        status = Article::Truncated;
+    }
+    QJSValue jsDocument = engine.newQObject(document.get());
 
-    QJSValue jsThis = d->engine.globalObject();
-    QJSValue readability = JSHelpers::callMemberConstructor(jsThis, "Readability", {jsDocument});
-    QJSValue parseResult = JSHelpers::callMember(readability, "parse");
-    QJSValue content = parseResult.property("content");
-    if (!content.isString()) {
-        return QString();
+    phases.start();
+    std::unique_ptr<StatsCollector> collector;
+    if (stats) {
+        collector = std::make_unique<StatsCollector>(profileNativeCalls);
     }
-    return content.toString();
+    QJSValue jsThis = engine.globalObject();
+    QJSValue readability = jsThis.property("Readability").callAsConstructor({jsDocument, jsOptionsFor(options)});
+    QJSValue parseResult = readability.isError() ? readability : readability.property("parse").callWithInstance(readability);
+    if (parseResult.isError()) {
+        // an interrupted script is an expected outcome, reported by the article's status
+        if (!watchdog || !watchdog->hasFired()) {
+            JSHelpers::logError(parseResult);
+        }
+        parseResult = QJSValue();
+    }
+    if (collector) {
+        collector->addTo(*stats);
+        collector.reset();
+        stats->grabArticleAttempts = readability.property("_grabArticlePasses").toInt();
+    }
+    phases.finish("extraction");
+    if (watchdog) {
+        watchdog->disarm();
+        if (watchdog->hasFired()) {
+            return Article(QJSValue(), watchdog->status());
+        }
+    }
+    if ((options.outputFormat != OutputFormat::Html || stats) && parseResult.isObject()) {
+        phases.start();
+        auto *articleNode = qobject_cast<DomSupport::AbstractContentNode *>(parseResult.property("content").toQObject());
+        if (articleNode) {
+            QString content;
+            switch (options.outputFormat) {
+            case OutputFormat::Html:
+                content = articleNode->innerHTML();
+                break;
+            case OutputFormat::PlainText:
+                content = TextSerializer::toPlainText(articleNode);
+                break;
+            case OutputFormat::Markdown:
+                content = TextSerializer::toMarkdown(articleNode);
+                break;
+            }
+            parseResult.setProperty("content", content);
+            if (stats) {
+                stats->outputSize = content.size();
+            }
+        }
+        phases.finish("serialization");
+    }
+    Article article(parseResult, status);
+    if (cache && status == Article::Complete) {
+        cache->insert(cacheKey, article);
+    }
+    return article;
+}
+
+bool Readable::isProbablyReaderable(const QByteArray &utf8data, const ReaderableOptions &options)
+{
+    ReaderableVisitor visitor(utf8data, options);
+    return visitor.isProbablyReaderable();
 }
 
 Readable::~Readable()=default;
@@ -5,18 +5,206 @@
 #pragma once
 
 #include <QObject>
+#include <QStringList>
 #include <QUrl>
 #include <memory>
+#include "article.h"
+#include "parselimits.h"
+#include "parsestats.h"
 #include "readable-defs.h"
 
 namespace QReadable {
+class ResultCache;
+
+/**
+ * Thresholds for Readable::isProbablyReaderable()
+ *
+ * The defaults match Readability-readerable.js
+ */
+struct ReaderableOptions {
+    /** The minimum node content length used to decide if the document is readerable */
+    int minContentLength{140};
+
+    /** The minimum cumulated score used to decide if the document is readerable */
+    double minScore{20};
+};
+
+/**
+ * The format of Article::content()
+ */
+enum class OutputFormat {
+    Html,       ///< the article's inner HTML, as produced by Readability.js
+    PlainText,  ///< text with line breaks between block elements
+    Markdown    ///< CommonMark-style Markdown
+};
+
+/**
+ * Options passed to Readability.js
+ *
+ * The defaults match Readability.js.  Lowering nbTopCandidates, setting
+ * disableJSONLD, or setting keepClasses (which skips the class cleaning
+ * pass) trade some extraction quality for speed.
+ */
+struct ReadableOptions {
+    /** Abort the parse if the document has more than this many elements (zero means no limit) */
+    int maxElemsToParse{0};
+
+    /** The number of top candidates to consider when analysing how tight the competition is among candidates */
+    int nbTopCandidates{5};
+
+    /** The number of characters an article must have in order to return a result */
+    int charThreshold{500};
+
+    /** Classes to keep on elements when keepClasses is false, in addition to Readability's own */
+    QStringList classesToPreserve;
+
+    /** Keep all classes on elements instead of stripping them */
+    bool keepClasses{false};
+
+    /** Don't look for metadata in JSON-LD script tags */
+    bool disableJSONLD{false};
+
+    /**
+     * The format of Article::content()
+     *
+     * PlainText and Markdown are generated natively from the article's
+     * DOM, and skip serializing the article to HTML.
+     */
+    OutputFormat outputFormat{OutputFormat::Html};
+
+    bool operator==(const ReadableOptions &other) const
+    {
+        return maxElemsToParse == other.maxElemsToParse
+                && nbTopCandidates == other.nbTopCandidates
+                && charThreshold == other.charThreshold
+                && classesToPreserve == other.classesToPreserve
+                && keepClasses == other.keepClasses
+                && disableJSONLD == other.disableJSONLD
+                && outputFormat == other.outputFormat;
+    }
+
+    bool operator!=(const ReadableOptions &other) const
+    {
+        return !(*this == other);
+    }
+};
+
 class QREADABLE_EXPORT Readable : public QObject
 {
     Q_OBJECT
 public:
     explicit Readable(QObject *parent = nullptr);
+
+    /**
+     * Create a Readable that uses \a options for every parse() that doesn't supply its own
+     */
+    explicit Readable(const ReadableOptions &options, QObject *parent = nullptr);
     ~Readable();
-    QString parse(const QString &htmlContent, const QUrl &url=QUrl());
+
+    ReadableOptions options() const;
+    void setOptions(const ReadableOptions &options);
+
+    /**
+     * Look up every parse in \a cache before running it, and store complete results in it
+     *
+     * The same cache can be shared by several Readables.  Pass nullptr to stop caching.
+     */
+    void setResultCache(std::shared_ptr<ResultCache> cache);
+    std::shared_ptr<ResultCache> resultCache() const;
+
+    /**
+     * Record a ParseStats for every parse, to be read with lastParseStats()
+     *
+     * This adds a little overhead to every call from Readability.js into
+     * the DOM, so it is off by default.
+     */
+    void setCollectStats(bool collect);
+    bool collectsStats() const;
+
+    /**
+     * Also time every call from Readability.js into the DOM, and measure what it passes
+     *
+     * The results are in ParseStats::nativeCalls (see nativeCallReport()).
+     * This makes parsing noticeably slower.  Turning profiling on turns on
+     * collecting stats, and turning collecting stats off turns profiling off.
+     */
+    void setProfileNativeCalls(bool profile);
+    bool profilesNativeCalls() const;
+
+    /**
+     * The stats for the most recent parse, or empty stats if they weren't being collected
+     */
+    ParseStats lastParseStats() const;
+
+    Article parse(const QString &htmlContent, const QUrl &url=QUrl());
+
+    /**
+     * Parse \a htmlContent with \a options instead of the default options
+     */
+    Article parse(const QString &htmlContent, const QUrl &url, const ReadableOptions &options);
+
+    /**
+     * Parse \a htmlContent within the budgets given by \a limits
+     *
+     * If a budget is exceeded the returned Article has a status other than
+     * Article::Complete, and may be null.
+     */
+    Article parse(const QString &htmlContent, const QUrl &url, const ParseLimits &limits);
+
+    /**
+     * Parse \a htmlContent with \a options, within the budgets given by \a limits
+     */
+    Article parse(const QString &htmlContent, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits);
+
+    /**
+     * Parse \a htmlContent within \a limits, stopping early if \a token is cancelled
+     */
+    Article parse(const QString &htmlContent, const QUrl &url, const ParseLimits &limits, const CancellationToken &token);
+
+    /**
+     * Parse \a htmlContent with \a options, within \a limits, stopping early if \a token is cancelled
+     */
+    Article parse(const QString &htmlContent, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken &token);
+
+    /**
+     * Parse the UTF-8 encoded HTML in \a utf8data with \a options, within \a limits
+     *
+     * This saves converting HTML that is already UTF-8 to a QString and back.
+     */
+    Article parse(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits);
+
+    /**
+     * Parse the UTF-8 encoded HTML in \a utf8data with \a options, within \a limits, stopping early if \a token is cancelled
+     */
+    Article parse(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken &token);
+
+    /**
+     * Parse the UTF-8 encoded HTML file at \a path
+     *
+     * The file is memory mapped and parsed in place rather than being read
+     * into memory and converted, which makes this the cheapest way to
+     * process large documents.  If the file can't be opened, the returned
+     * Article is null with status Article::ReadError.
+     */
+    Article parseFile(const QString &path, const QUrl &url=QUrl());
+
+    /**
+     * Parse the HTML file at \a path with \a options, within the budgets given by \a limits
+     */
+    Article parseFile(const QString &path, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits);
+
+    /**
+     * Parse the HTML file at \a path with \a options, within \a limits, stopping early if \a token is cancelled
+     */
+    Article parseFile(const QString &path, const QUrl &url, const ReadableOptions &options, const ParseLimits &limits, const CancellationToken &token);
+
+    /**
+     * Quickly decide whether parse() is likely to find an article in \a utf8data
+     *
+     * This works directly on the HTML parse tree, without building a DOM or
+     * running any script, so it is much cheaper than a full parse.
+     */
+    static bool isProbablyReaderable(const QByteArray &utf8data, const ReaderableOptions &options=ReaderableOptions());
 
 private:
     struct PrivData;
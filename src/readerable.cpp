@@ -0,0 +1,165 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "readerable.h"
+#include <QStack>
+#include <QtMath>
+#include "classifier.h"
+using namespace QReadable;
+
+namespace {
+struct OpenElement {
+    bool isCandidate;
+    int textStart;
+};
+}
+
+struct ReaderableVisitor::PrivData {
+    ReaderableOptions options;
+    QStack<OpenElement> elementStack;
+    int openCandidates{0};
+    int listItemDepth{0};
+    QString text;
+    double score{0};
+    bool result{false};
+};
+
+static QString attributeValue(const GumboElement &element, const char *name)
+{
+    const GumboAttribute *attr = gumbo_get_attribute(&element.attributes, name);
+    return attr ? QString::fromUtf8(attr->value) : QString();
+}
+
+static bool hasDisplayNone(const GumboElement &element)
+{
+    const QString style = attributeValue(element, "style");
+    if (style.isEmpty()) {
+        return false;
+    }
+    const QStringList declarations = style.split(";");
+    for (const QString &css : declarations) {
+        QStringList splitCss = css.split(":");
+        if (splitCss.length() != 2) {
+            continue;
+        }
+        if (splitCss.first().trimmed() == QLatin1String("display")) {
+            return splitCss.last().trimmed() == QLatin1String("none");
+        }
+    }
+    return false;
+}
+
+static bool isNodeVisible(const GumboElement &element)
+{
+    if (hasDisplayNone(element)) {
+        return false;
+    }
+    if (gumbo_get_attribute(&element.attributes, "hidden")) {
+        return false;
+    }
+    const GumboAttribute *ariaHidden = gumbo_get_attribute(&element.attributes, "aria-hidden");
+    if (ariaHidden && qstrcmp(ariaHidden->value, "true") == 0) {
+        // check for "fallback-image" so that wikimedia math images are displayed
+        return attributeValue(element, "class").contains(QLatin1String("fallback-image"));
+    }
+    return true;
+}
+
+static bool hasChildBr(const GumboElement &element)
+{
+    for (unsigned int i=0; i<element.children.length; i++) {
+        auto *child = static_cast<GumboNode *>(element.children.data[i]);
+        if (child->type == GUMBO_NODE_ELEMENT && child->v.element.tag == GUMBO_TAG_BR) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ReaderableVisitor::ReaderableVisitor(const QByteArray &utf8data, const ReaderableOptions &options)
+    : GumboVisitor(utf8data)
+    , d{std::make_unique<PrivData>()}
+{
+    d->options = options;
+}
+
+ReaderableVisitor::~ReaderableVisitor() = default;
+
+bool ReaderableVisitor::isProbablyReaderable()
+{
+    walk();
+    return d->result;
+}
+
+void ReaderableVisitor::visitElementOpen(GumboNode *node)
+{
+    const GumboElement &element = node->v.element;
+    bool isCandidate = false;
+    switch (element.tag) {
+    case GUMBO_TAG_P:
+        isCandidate = d->listItemDepth == 0;
+        break;
+    case GUMBO_TAG_PRE:
+    case GUMBO_TAG_ARTICLE:
+        isCandidate = true;
+        break;
+    case GUMBO_TAG_DIV:
+        isCandidate = hasChildBr(element);
+        break;
+    case GUMBO_TAG_LI:
+        d->listItemDepth++;
+        break;
+    default:
+        break;
+    }
+
+    if (isCandidate && !isNodeVisible(element)) {
+        isCandidate = false;
+    }
+
+    if (isCandidate) {
+        int flags = Classifier::classify(attributeValue(element, "class"), attributeValue(element, "id"),
+                                         Classifier::UnlikelyCandidate | Classifier::OkMaybeItsACandidate);
+        if (flags == Classifier::UnlikelyCandidate) {
+            isCandidate = false;
+        }
+    }
+
+    if (isCandidate) {
+        d->openCandidates++;
+    }
+    d->elementStack.push({isCandidate, d->text.length()});
+}
+
+void ReaderableVisitor::visitText(GumboNode *node)
+{
+    if (d->openCandidates > 0) {
+        d->text += QString::fromUtf8(node->v.text.text);
+    }
+}
+
+void ReaderableVisitor::visitElementClose(GumboNode *node)
+{
+    if (node->v.element.tag == GUMBO_TAG_LI) {
+        d->listItemDepth--;
+    }
+    OpenElement closed = d->elementStack.pop();
+    if (!closed.isCandidate) {
+        return;
+    }
+
+    const int textContentLength = QStringView(d->text).mid(closed.textStart).trimmed().length();
+    if (--d->openCandidates == 0) {
+        d->text.clear();
+    }
+    if (textContentLength < d->options.minContentLength) {
+        return;
+    }
+
+    d->score += qSqrt(textContentLength - d->options.minContentLength);
+    if (d->score > d->options.minScore) {
+        d->result = true;
+        stopWalk();
+    }
+}
@@ -0,0 +1,40 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include "gumbovisitor.h"
+#include "readable.h"
+#include <memory>
+
+namespace QReadable {
+/**
+ * Native port of Readability-readerable.js
+ *
+ * Decides whether a document is likely to contain an article by
+ * looking at the text length of its <p>, <pre> and <article> elements
+ * (and <div>s containing <br>s), working directly on the Gumbo parse
+ * tree. No DOM nodes are created and no script is run.
+ */
+class ReaderableVisitor : public GumboVisitor<ReaderableVisitor>
+{
+public:
+    ReaderableVisitor(const QByteArray &utf8data, const ReaderableOptions &options);
+    ~ReaderableVisitor();
+
+    /**
+     * Walk the parse tree and return true if the document is probably readerable
+     */
+    bool isProbablyReaderable();
+
+private:
+    struct PrivData;
+    std::unique_ptr<PrivData> d;
+
+    friend class GumboVisitor<ReaderableVisitor>;
+    void visitElementOpen(GumboNode *node);
+    void visitText(GumboNode *node);
+    void visitElementClose(GumboNode *node);
+};
+}
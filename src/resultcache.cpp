@@ -0,0 +1,353 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "resultcache.h"
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QtEndian>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include "readable.h"
+using namespace QReadable;
+
+// The store holds results, not just their format, so it names the versions that
+// produced them: bump the qreadable revision whenever Readability.js or the native
+// DOM and serializers change what a parse returns.  Stores from other versions are discarded.
+static constexpr char kStoreMagic[] = "QRCACHE2 readability-0.4.2 qreadable-2\n";
+static constexpr qint64 kStoreHeaderSize = sizeof(kStoreMagic) - 1;
+
+// key, payload length, payload, checksum
+static constexpr qint64 kRecordOverhead = 8 + 8 + 4 + 8;
+
+// XXH64, from the xxHash specification
+static constexpr quint64 kPrime1 = 0x9E3779B185EBCA87ULL;
+static constexpr quint64 kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr quint64 kPrime3 = 0x165667B19E3779F9ULL;
+static constexpr quint64 kPrime4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr quint64 kPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline quint64 rotl(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64 read64(const uchar *p)
+{
+    quint64 value;
+    memcpy(&value, p, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+static inline quint32 read32(const uchar *p)
+{
+    quint32 value;
+    memcpy(&value, p, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+static inline quint64 round64(quint64 acc, quint64 input)
+{
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+static inline quint64 mergeRound(quint64 acc, quint64 value)
+{
+    acc ^= round64(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+static quint64 xxh64(const char *data, qint64 length, quint64 seed)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + length;
+    quint64 h;
+    if (length >= 32) {
+        const uchar *limit = end - 32;
+        quint64 v1 = seed + kPrime1 + kPrime2;
+        quint64 v2 = seed + kPrime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - kPrime1;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    h += static_cast<quint64>(length);
+    for (; p + 8 <= end; p += 8) {
+        h ^= round64(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= quint64(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+    }
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+static quint64 xxh64(const QByteArray &data, quint64 seed)
+{
+    return xxh64(data.constData(), data.size(), seed);
+}
+
+static QByteArray encode(const Article &article)
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << article.toVariantMap();
+    return bytes;
+}
+
+static Article decode(const QByteArray &bytes)
+{
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_5_6);
+    QVariantMap fields;
+    stream >> fields;
+    return Article(fields);
+}
+
+struct ResultCache::PrivData {
+    using Entry = std::pair<Key, QByteArray>;
+
+    mutable std::mutex mutex;
+    Stats stats;
+
+    // most recently used first
+    qint64 maxMemoryBytes;
+    std::list<Entry> lru;
+    QHash<Key, std::list<Entry>::iterator> memoryIndex;
+
+    struct StoreLocation {
+        qint64 offset;
+        quint32 length;
+    };
+    qint64 maxDiskBytes{0};
+    QFile store;
+    const uchar *mapping{nullptr};
+    qint64 mappedSize{0};
+    QHash<Key, StoreLocation> storeIndex;
+
+    void insertInMemory(const Key &key, const QByteArray &bytes);
+    bool readFromStore(const StoreLocation &location, QByteArray &bytes);
+    void appendToStore(const Key &key, const QByteArray &bytes);
+    void loadStore();
+    void resetStore();
+};
+
+void ResultCache::PrivData::insertInMemory(const Key &key, const QByteArray &bytes)
+{
+    lru.emplace_front(key, bytes);
+    memoryIndex.insert(key, lru.begin());
+    stats.memoryBytes += bytes.size();
+    while (stats.memoryBytes > maxMemoryBytes && !lru.empty()) {
+        const Entry &oldest = lru.back();
+        stats.memoryBytes -= oldest.second.size();
+        memoryIndex.remove(oldest.first);
+        lru.pop_back();
+        stats.memoryEvictions++;
+    }
+}
+
+bool ResultCache::PrivData::readFromStore(const StoreLocation &location, QByteArray &bytes)
+{
+    if (location.offset + location.length <= mappedSize) {
+        bytes = QByteArray(reinterpret_cast<const char *>(mapping) + location.offset, location.length);
+        return true;
+    }
+    // appended since the store was mapped
+    if (!store.seek(location.offset)) {
+        return false;
+    }
+    bytes = store.read(location.length);
+    return bytes.size() == static_cast<int>(location.length);
+}
+
+void ResultCache::PrivData::appendToStore(const Key &key, const QByteArray &bytes)
+{
+    if (storeIndex.contains(key)) {
+        return;
+    }
+    qint64 recordSize = kRecordOverhead + bytes.size();
+    if (kStoreHeaderSize + recordSize > maxDiskBytes) {
+        return;
+    }
+    if (store.size() + recordSize > maxDiskBytes) {
+        resetStore();
+        stats.diskResets++;
+    }
+
+    QByteArray record(kRecordOverhead + bytes.size(), Qt::Uninitialized);
+    char *p = record.data();
+    qToLittleEndian<quint64>(key.high, p);
+    qToLittleEndian<quint64>(key.low, p + 8);
+    qToLittleEndian<quint32>(static_cast<quint32>(bytes.size()), p + 16);
+    memcpy(p + 20, bytes.constData(), bytes.size());
+    // lets loadStore() detect a record torn by a crash
+    qToLittleEndian<quint64>(xxh64(bytes, key.low), p + 20 + bytes.size());
+
+    qint64 offset = store.size();
+    if (!store.seek(offset) || store.write(record) != record.size()) {
+        return;
+    }
+    store.flush();
+    storeIndex.insert(key, StoreLocation{offset + 20, static_cast<quint32>(bytes.size())});
+    stats.diskBytes = store.size();
+}
+
+void ResultCache::PrivData::loadStore()
+{
+    qint64 size = store.size();
+    if (size < kStoreHeaderSize) {
+        resetStore();
+        return;
+    }
+    mapping = store.map(0, size);
+    if (!mapping || memcmp(mapping, kStoreMagic, kStoreHeaderSize) != 0) {
+        resetStore();
+        return;
+    }
+    mappedSize = size;
+
+    qint64 offset = kStoreHeaderSize;
+    while (offset + kRecordOverhead <= size) {
+        const uchar *p = mapping + offset;
+        Key key{read64(p), read64(p + 8)};
+        quint32 length = read32(p + 16);
+        if (offset + kRecordOverhead + length > size) {
+            break;
+        }
+        const char *payload = reinterpret_cast<const char *>(p + 20);
+        if (read64(p + 20 + length) != xxh64(payload, length, key.low)) {
+            break;
+        }
+        storeIndex.insert(key, StoreLocation{offset + 20, length});
+        offset += kRecordOverhead + length;
+    }
+    if (offset < size) {
+        // drop a partially written record at the end
+        store.unmap(const_cast<uchar *>(mapping));
+        mapping = nullptr;
+        mappedSize = 0;
+        store.resize(offset);
+        mapping = store.map(0, offset);
+        mappedSize = mapping ? offset : 0;
+    }
+    stats.diskBytes = store.size();
+}
+
+void ResultCache::PrivData::resetStore()
+{
+    if (mapping) {
+        store.unmap(const_cast<uchar *>(mapping));
+        mapping = nullptr;
+        mappedSize = 0;
+    }
+    storeIndex.clear();
+    store.resize(0);
+    store.seek(0);
+    store.write(kStoreMagic, kStoreHeaderSize);
+    store.flush();
+    stats.diskBytes = store.size();
+}
+
+ResultCache::ResultCache(qint64 maxMemoryBytes)
+    : d{std::make_unique<PrivData>()}
+{
+    d->maxMemoryBytes = maxMemoryBytes;
+}
+
+ResultCache::~ResultCache() = default;
+
+bool ResultCache::setDiskStore(const QString &path, qint64 maxDiskBytes)
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->store.setFileName(path);
+    if (!d->store.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    d->maxDiskBytes = maxDiskBytes;
+    d->loadStore();
+    return true;
+}
+
+ResultCache::Key ResultCache::key(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options)
+{
+    QByteArray context;
+    QDataStream stream(&context, QIODevice::WriteOnly);
+    stream << url.toEncoded() << options.maxElemsToParse << options.nbTopCandidates << options.charThreshold
+           << options.classesToPreserve << options.keepClasses << options.disableJSONLD
+           << static_cast<int>(options.outputFormat);
+    quint64 contextHash = xxh64(context, 0);
+    // two independent 64-bit hashes of the content make collisions negligible
+    return Key{xxh64(utf8data, contextHash), xxh64(utf8data, ~contextHash)};
+}
+
+bool ResultCache::lookup(const Key &key, Article &article)
+{
+    QByteArray bytes;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        auto inMemory = d->memoryIndex.find(key);
+        if (inMemory != d->memoryIndex.end()) {
+            d->lru.splice(d->lru.begin(), d->lru, inMemory.value());
+            d->stats.memoryHits++;
+            bytes = inMemory.value()->second;
+        } else {
+            auto inStore = d->storeIndex.find(key);
+            if (inStore == d->storeIndex.end() || !d->readFromStore(inStore.value(), bytes)) {
+                d->stats.misses++;
+                return false;
+            }
+            d->stats.diskHits++;
+            d->insertInMemory(key, bytes);
+        }
+    }
+    article = decode(bytes);
+    return true;
+}
+
+void ResultCache::insert(const Key &key, const Article &article)
+{
+    QByteArray bytes = encode(article);
+    std::lock_guard<std::mutex> lock(d->mutex);
+    if (d->memoryIndex.contains(key)) {
+        return;
+    }
+    d->stats.insertions++;
+    d->insertInMemory(key, bytes);
+    if (d->store.isOpen()) {
+        d->appendToStore(key, bytes);
+    }
+}
+
+ResultCache::Stats ResultCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->stats;
+}
@@ -0,0 +1,88 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+#include <memory>
+#include "article.h"
+#include "readable-defs.h"
+
+namespace QReadable {
+struct ReadableOptions;
+
+/**
+ * A cache of extraction results keyed by the content they were extracted from
+ *
+ * Results are keyed by a 128-bit hash of the input HTML, the document
+ * URL and the options, so repeated extractions of the same content cost a
+ * hash and a lookup instead of a parse.  Recently used results are kept
+ * in memory; if a disk store is set, every result is also appended to it
+ * so that it survives the process.
+ *
+ * A ResultCache is thread safe, so one cache can be shared by several
+ * Readables (see Readable::setResultCache()).
+ */
+class QREADABLE_EXPORT ResultCache
+{
+public:
+    struct Key {
+        quint64 high;
+        quint64 low;
+        bool operator==(const Key &other) const { return high == other.high && low == other.low; }
+    };
+
+    struct Stats {
+        quint64 memoryHits{0};
+        quint64 diskHits{0};
+        quint64 misses{0};
+        quint64 insertions{0};
+        quint64 memoryEvictions{0};   ///< results dropped from memory to stay under the memory cap
+        quint64 diskResets{0};        ///< times the disk store was emptied to stay under the disk cap
+        qint64 memoryBytes{0};
+        qint64 diskBytes{0};
+    };
+
+    /**
+     * Create a cache holding up to \a maxMemoryBytes of results in memory
+     */
+    explicit ResultCache(qint64 maxMemoryBytes=64 * 1024 * 1024);
+    ~ResultCache();
+    ResultCache(ResultCache &other) = delete;
+    void operator=(ResultCache &other) = delete;
+
+    /**
+     * Keep results in the append-only file at \a path, up to \a maxDiskBytes
+     *
+     * Results already in the file are available immediately.  When the
+     * file reaches its cap it is emptied and filled again from scratch.
+     */
+    bool setDiskStore(const QString &path, qint64 maxDiskBytes=1024 * 1024 * 1024);
+
+    static Key key(const QByteArray &utf8data, const QUrl &url, const ReadableOptions &options);
+
+    /**
+     * Look up the result for \a key, returning true and setting \a article if found
+     */
+    bool lookup(const Key &key, Article &article);
+
+    /**
+     * Store \a article as the result for \a key
+     */
+    void insert(const Key &key, const Article &article);
+
+    Stats stats() const;
+
+private:
+    struct PrivData;
+    std::unique_ptr<PrivData> d;
+};
+
+inline uint qHash(const ResultCache::Key &key, uint seed=0)
+{
+    return static_cast<uint>(key.low ^ (key.low >> 32)) ^ seed;
+}
+}
@@ -0,0 +1,34 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "statscollector.h"
+using namespace QReadable;
+
+static thread_local StatsCollector *currentCollector = nullptr;
+
+StatsCollector::StatsCollector(bool profile)
+    : m_previous(currentCollector)
+    , m_profile(profile)
+{
+    currentCollector = this;
+}
+
+StatsCollector::~StatsCollector()
+{
+    currentCollector = m_previous;
+}
+
+StatsCollector *StatsCollector::current()
+{
+    return currentCollector;
+}
+
+void StatsCollector::addTo(ParseStats &stats) const
+{
+    stats.elementsRemoved += m_elementsRemoved;
+    for (auto it = m_calls.cbegin(); it != m_calls.cend(); ++it) {
+        // the same name may appear under more than one literal
+        stats.nativeCalls[QString::fromLatin1(it.key())] += it.value();
+    }
+}
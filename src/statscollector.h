@@ -0,0 +1,137 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <chrono>
+#include "parsestats.h"
+
+namespace QReadable {
+/**
+ * Approximately how many bytes of \a value cross between script and the DOM
+ */
+inline qint64 marshalledSize(const QString &value)
+{
+    return value.size() * qint64(sizeof(QChar));
+}
+
+inline qint64 marshalledSize(const QUrl &value)
+{
+    return marshalledSize(value.toString());
+}
+
+template<typename T>
+qint64 marshalledSize(const QList<T> &value)
+{
+    return value.size() * qint64(sizeof(T));
+}
+
+template<typename T>
+qint64 marshalledSize(const T &)
+{
+    return sizeof(T);
+}
+
+/**
+ * Counts calls into the native DOM while it is installed on the current thread
+ *
+ * Only the outermost native call is counted, so DOM methods that call
+ * each other internally are counted once, as the script called them.
+ * When profiling, each call is also timed, and the size of its arguments
+ * and result is added up.
+ */
+class StatsCollector
+{
+public:
+    explicit StatsCollector(bool profile=false);
+    ~StatsCollector();
+    StatsCollector(StatsCollector &other) = delete;
+    void operator=(StatsCollector &other) = delete;
+
+    /**
+     * The collector installed on this thread, if any
+     */
+    static StatsCollector *current();
+
+    /**
+     * Add the counts so far to \a stats
+     */
+    void addTo(ParseStats &stats) const;
+
+    /**
+     * Marks a call into the DOM for as long as it is in scope
+     */
+    class Call
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        template<typename... Arguments>
+        explicit Call(const char *member, const Arguments &...arguments)
+            : m_collector(current())
+        {
+            if (m_collector && m_collector->m_depth++ == 0) {
+                m_totals = &m_collector->m_calls[member];
+                m_totals->count++;
+                if (m_collector->m_profile) {
+                    m_totals->bytes += (qint64(0) + ... + marshalledSize(arguments));
+                    m_start = Clock::now();
+                }
+            }
+        }
+
+        ~Call()
+        {
+            if (!m_collector) {
+                return;
+            }
+            if (m_totals && m_collector->m_profile) {
+                m_totals->totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count();
+            }
+            m_collector->m_depth--;
+        }
+
+        /**
+         * Pass through the call's return value, counting its size when profiling
+         */
+        template<typename T>
+        T result(T value)
+        {
+            if (m_totals && m_collector->m_profile) {
+                m_totals->bytes += marshalledSize(value);
+            }
+            return value;
+        }
+
+        /**
+         * The collector, if this call came from script rather than another DOM method
+         */
+        StatsCollector *outermost() const { return m_totals ? m_collector : nullptr; }
+
+    private:
+        StatsCollector *m_collector;
+        NativeCallStats *m_totals{nullptr};
+        Clock::time_point m_start;
+    };
+
+    int m_elementsRemoved{0};
+
+private:
+    StatsCollector *m_previous;
+    bool m_profile;
+    int m_depth{0};
+    // keyed by the member name literal, which is cheaper to hash than its contents
+    QHash<const char *, NativeCallStats> m_calls;
+};
+}
+
+// Counts (or profiles) the enclosing DOM method as a call from script
+#define QREADABLE_NATIVE_CALL(...) QReadable::StatsCollector::Call nativeCall_(__VA_ARGS__)
+
+// Returns value from a method marked with QREADABLE_NATIVE_CALL
+#define QREADABLE_NATIVE_RESULT(value) nativeCall_.result(value)
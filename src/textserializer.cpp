@@ -0,0 +1,649 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "textserializer.h"
+#include <QVector>
+#include <gumbo/gumbo.h>
+#include "domsupport.h"
+using namespace QReadable;
+using namespace QReadable::DomSupport;
+
+namespace {
+/**
+ * Accumulates output text, collapsing whitespace and tracking line breaks
+ *
+ * Line and block breaks are held back until the next piece of content is
+ * written, so that consecutive breaks collapse and no trailing breaks are
+ * emitted.  Every new line starts with the current prefix (blockquote
+ * markers and list indentation).
+ */
+class TextWriter
+{
+public:
+    void text(const QString &text, bool escapeMarkdown, bool escapePipes);
+    void preformatted(const QString &text);
+
+    /**
+     * Write markup that starts new content, such as a link's "["
+     */
+    void markup(const QString &markup);
+
+    /**
+     * Write markup that attaches to the following content, such as an opening "**"
+     *
+     * It is held back until that content is written, so that the space
+     * before the content goes before the markup.
+     */
+    void openingMarkup(const QString &markup)
+    {
+        m_pendingMarkup += markup;
+    }
+
+    /**
+     * Write markup that attaches to the preceding content, such as a closing "**"
+     */
+    void closingMarkup(const QString &markup)
+    {
+        if (!m_pendingMarkup.isEmpty()) {
+            beginContent();
+        }
+        m_out += markup;
+    }
+
+    /**
+     * Write a marker, such as a list bullet, that begins a line
+     *
+     * Breaks requested before the line has any other content are ignored,
+     * so that a <p> inside an <li> stays on the bullet's line.
+     */
+    void lineMarker(const QString &marker);
+
+    void lineBreak()
+    {
+        m_pendingBreak = qMax(m_pendingBreak, 1);
+    }
+
+    void blockBreak()
+    {
+        m_pendingBreak = 2;
+    }
+
+    void discardSpace()
+    {
+        m_pendingSpace = false;
+    }
+
+    void pushPrefix(const QString &prefix)
+    {
+        m_prefix += prefix;
+    }
+
+    void popPrefix(int length)
+    {
+        m_prefix.chop(length);
+    }
+
+    QString result() const;
+
+private:
+    QString m_out;
+    QString m_prefix;
+    QString m_pendingMarkup;
+    int m_pendingBreak{0};
+    bool m_lineStart{true};
+    bool m_lineEmpty{false};
+    bool m_pendingSpace{false};
+    bool beginContent();
+};
+
+struct ListState {
+    bool ordered;
+    int counter;
+};
+
+struct TableState {
+    int rows;
+    int cells;
+    // a table inside a cell is written as plain text in that cell
+    bool flattened;
+};
+
+class Serializer
+{
+public:
+    explicit Serializer(bool markdown)
+        : m_markdown(markdown)
+    {}
+
+    QString run(Node *root);
+
+private:
+    bool m_markdown;
+    TextWriter m_writer;
+    QVector<ListState> m_lists;
+    QVector<TableState> m_tables;
+    QVector<int> m_listPrefixLengths;
+    int m_preDepth{0};
+    int m_codeDepth{0};
+    int m_cellDepth{0};
+
+    bool enter(Node *node);
+    bool enterElement(Element *element);
+    void leave(Node *node);
+    void leaveElement(Element *element);
+    void lineBreak();
+    void blockBreak();
+
+    bool inFlattenedTable() const
+    {
+        return !m_tables.isEmpty() && m_tables.last().flattened;
+    }
+};
+}
+
+static bool isAsciiSpace(QChar c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+// The index of the character to escape so that \a word, at the start of a line,
+// isn't read as a heading, quote, list item or rule marker, or -1
+static int blockMarkerIndex(QStringView word)
+{
+    const QChar first = word.front();
+    if (first == '#' || first == '>') {
+        return 0;
+    }
+    if (first == '-' || first == '+' || first == '=') {
+        for (QChar c : word) {
+            if (c != first) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    int digits = 0;
+    while (digits < word.size() && word.at(digits) >= '0' && word.at(digits) <= '9') {
+        ++digits;
+    }
+    if (digits > 0 && digits <= 9 && digits == word.size() - 1 && (word.back() == '.' || word.back() == ')')) {
+        return digits;
+    }
+    return -1;
+}
+
+static void appendEscaped(QString &out, QStringView text, bool escapePipes = false, bool atLineStart = false)
+{
+    const int markerIndex = atLineStart && !text.isEmpty() ? blockMarkerIndex(text) : -1;
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        switch (c.unicode()) {
+        case '\\':
+        case '*':
+        case '_':
+        case '`':
+        case '[':
+        case ']':
+            out += '\\';
+            break;
+        case '|':
+            if (escapePipes) {
+                out += '\\';
+            }
+            break;
+        default:
+            if (i == markerIndex) {
+                out += '\\';
+            }
+            break;
+        }
+        out += c;
+    }
+}
+
+static bool isBlockElement(int tag)
+{
+    switch (tag) {
+    case GUMBO_TAG_ADDRESS:
+    case GUMBO_TAG_ARTICLE:
+    case GUMBO_TAG_ASIDE:
+    case GUMBO_TAG_CAPTION:
+    case GUMBO_TAG_DD:
+    case GUMBO_TAG_DETAILS:
+    case GUMBO_TAG_DIALOG:
+    case GUMBO_TAG_DIV:
+    case GUMBO_TAG_DL:
+    case GUMBO_TAG_DT:
+    case GUMBO_TAG_FIELDSET:
+    case GUMBO_TAG_FIGCAPTION:
+    case GUMBO_TAG_FIGURE:
+    case GUMBO_TAG_FOOTER:
+    case GUMBO_TAG_FORM:
+    case GUMBO_TAG_HEADER:
+    case GUMBO_TAG_LEGEND:
+    case GUMBO_TAG_MAIN:
+    case GUMBO_TAG_NAV:
+    case GUMBO_TAG_SECTION:
+    case GUMBO_TAG_SUMMARY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Returns true if the content is the first on its line, after any prefix and marker
+bool TextWriter::beginContent()
+{
+    if (m_pendingBreak > 0 && !m_lineEmpty) {
+        if (!m_out.isEmpty()) {
+            m_out += '\n';
+            if (m_pendingBreak > 1) {
+                // blank lines inside a blockquote keep the quote marker
+                QString blankPrefix = m_prefix;
+                while (blankPrefix.endsWith(' ')) {
+                    blankPrefix.chop(1);
+                }
+                m_out += blankPrefix;
+                m_out += '\n';
+            }
+        }
+        m_lineStart = true;
+    }
+    const bool startsLine = (m_lineStart || m_lineEmpty) && m_pendingMarkup.isEmpty();
+    m_pendingBreak = 0;
+    m_lineEmpty = false;
+    if (m_lineStart) {
+        m_out += m_prefix;
+        m_lineStart = false;
+    } else if (m_pendingSpace && !m_out.endsWith(' ')) {
+        // a table cell's markup already ends in a space
+        m_out += ' ';
+    }
+    m_pendingSpace = false;
+    m_out += m_pendingMarkup;
+    m_pendingMarkup.clear();
+    return startsLine;
+}
+
+void TextWriter::text(const QString &text, bool escapeMarkdown, bool escapePipes)
+{
+    const int length = text.length();
+    int i = 0;
+    while (i < length) {
+        if (isAsciiSpace(text.at(i))) {
+            m_pendingSpace = true;
+            ++i;
+            continue;
+        }
+        int wordStart = i;
+        while (i < length && !isAsciiSpace(text.at(i))) {
+            ++i;
+        }
+        const bool startsLine = beginContent();
+        QStringView word = QStringView(text).mid(wordStart, i - wordStart);
+        if (escapeMarkdown) {
+            appendEscaped(m_out, word, escapePipes, startsLine);
+        } else if (escapePipes) {
+            // code spans in a table cell still need their pipes escaped
+            m_out += word.toString().replace('|', QLatin1String("\\|"));
+        } else {
+            m_out.append(word.data(), word.size());
+        }
+    }
+}
+
+void TextWriter::preformatted(const QString &text)
+{
+    m_pendingSpace = false;
+    const QStringList lines = text.split('\n');
+    for (int i=0; i<lines.length(); i++) {
+        if (i > 0) {
+            m_out += '\n';
+            m_lineStart = true;
+        }
+        beginContent();
+        m_out += lines.at(i);
+    }
+}
+
+void TextWriter::markup(const QString &markup)
+{
+    beginContent();
+    m_out += markup;
+}
+
+void TextWriter::lineMarker(const QString &marker)
+{
+    beginContent();
+    m_out += marker;
+    m_lineEmpty = true;
+}
+
+QString TextWriter::result() const
+{
+    int end = m_out.length();
+    while (end > 0 && m_out.at(end - 1).isSpace()) {
+        --end;
+    }
+    return m_out.left(end);
+}
+
+void Serializer::lineBreak()
+{
+    if (m_cellDepth > 0) {
+        m_writer.text(QStringLiteral(" "), false, false);
+    } else {
+        m_writer.lineBreak();
+    }
+}
+
+void Serializer::blockBreak()
+{
+    if (m_cellDepth > 0) {
+        m_writer.text(QStringLiteral(" "), false, false);
+    } else {
+        m_writer.blockBreak();
+    }
+}
+
+QString Serializer::run(Node *root)
+{
+    Node *node = root->firstChild();
+    while (node) {
+        if (enter(node)) {
+            if (Node *child = node->firstChild()) {
+                node = child;
+                continue;
+            }
+        }
+        leave(node);
+        while (!node->m_nextSibling) {
+            node = node->m_parentNode;
+            if (!node || node == root) {
+                return m_writer.result();
+            }
+            leave(node);
+        }
+        node = node->m_nextSibling;
+    }
+    return m_writer.result();
+}
+
+bool Serializer::enter(Node *node)
+{
+    switch (node->nodeType()) {
+    case Node::TEXT_NODE: {
+        QString text = static_cast<Text *>(node)->textContent();
+        if (m_preDepth > 0) {
+            m_writer.preformatted(text);
+        } else {
+            m_writer.text(text, m_markdown && m_codeDepth == 0, m_markdown && m_cellDepth > 0);
+        }
+        return false;
+    }
+    case Node::ELEMENT_NODE:
+        return enterElement(static_cast<Element *>(node));
+    default:
+        return false;
+    }
+}
+
+void Serializer::leave(Node *node)
+{
+    if (node->nodeType() == Node::ELEMENT_NODE) {
+        leaveElement(static_cast<Element *>(node));
+    }
+}
+
+bool Serializer::enterElement(Element *element)
+{
+    const int tag = element->gumboTag();
+    switch (tag) {
+    case GUMBO_TAG_HEAD:
+    case GUMBO_TAG_NOSCRIPT:
+    case GUMBO_TAG_SCRIPT:
+    case GUMBO_TAG_STYLE:
+    case GUMBO_TAG_TEMPLATE:
+    case GUMBO_TAG_TITLE:
+        return false;
+    case GUMBO_TAG_BR:
+        lineBreak();
+        return false;
+    case GUMBO_TAG_HR:
+        blockBreak();
+        if (m_markdown && m_cellDepth == 0) {
+            m_writer.markup(QStringLiteral("---"));
+            m_writer.blockBreak();
+        }
+        return false;
+    case GUMBO_TAG_IMG:
+        if (m_markdown) {
+            QString src = element->getAttribute("src");
+            if (!src.isEmpty()) {
+                QString markup = QStringLiteral("![");
+                appendEscaped(markup, element->getAttribute("alt"), m_cellDepth > 0);
+                markup += QStringLiteral("](") + src + ')';
+                m_writer.markup(markup);
+            }
+        }
+        return false;
+    case GUMBO_TAG_H1:
+    case GUMBO_TAG_H2:
+    case GUMBO_TAG_H3:
+    case GUMBO_TAG_H4:
+    case GUMBO_TAG_H5:
+    case GUMBO_TAG_H6:
+        blockBreak();
+        if (m_markdown && m_cellDepth == 0) {
+            m_writer.lineMarker(QString(tag - GUMBO_TAG_H1 + 1, '#') + ' ');
+        }
+        return true;
+    case GUMBO_TAG_P:
+        blockBreak();
+        return true;
+    case GUMBO_TAG_PRE:
+        blockBreak();
+        if (m_markdown) {
+            m_writer.markup(QStringLiteral("```"));
+            m_writer.lineBreak();
+        }
+        m_preDepth++;
+        return true;
+    case GUMBO_TAG_CODE:
+        if (m_markdown && m_preDepth == 0) {
+            m_writer.markup(QStringLiteral("`"));
+        }
+        m_codeDepth++;
+        return true;
+    case GUMBO_TAG_B:
+    case GUMBO_TAG_STRONG:
+        if (m_markdown) {
+            m_writer.openingMarkup(QStringLiteral("**"));
+        }
+        return true;
+    case GUMBO_TAG_I:
+    case GUMBO_TAG_EM:
+        if (m_markdown) {
+            m_writer.openingMarkup(QStringLiteral("*"));
+        }
+        return true;
+    case GUMBO_TAG_A:
+        if (m_markdown && !element->getAttribute("href").isEmpty()) {
+            m_writer.markup(QStringLiteral("["));
+        }
+        return true;
+    case GUMBO_TAG_UL:
+    case GUMBO_TAG_OL:
+        if (m_lists.isEmpty()) {
+            blockBreak();
+        } else {
+            lineBreak();
+        }
+        m_lists.append(ListState{tag == GUMBO_TAG_OL, 0});
+        return true;
+    case GUMBO_TAG_LI: {
+        lineBreak();
+        QString marker = QStringLiteral("- ");
+        if (!m_lists.isEmpty() && m_lists.last().ordered) {
+            marker = QStringLiteral("%1. ").arg(++m_lists.last().counter);
+        }
+        if (m_cellDepth > 0) {
+            m_listPrefixLengths.append(0);
+            return true;
+        }
+        m_writer.lineMarker(marker);
+        m_writer.pushPrefix(QString(marker.length(), ' '));
+        m_listPrefixLengths.append(marker.length());
+        return true;
+    }
+    case GUMBO_TAG_BLOCKQUOTE:
+        blockBreak();
+        if (m_markdown && m_cellDepth == 0) {
+            m_writer.pushPrefix(QStringLiteral("> "));
+        }
+        return true;
+    case GUMBO_TAG_TABLE:
+        blockBreak();
+        m_tables.append(TableState{0, 0, m_cellDepth > 0});
+        return true;
+    case GUMBO_TAG_TR:
+        lineBreak();
+        if (!m_tables.isEmpty()) {
+            m_tables.last().cells = 0;
+        }
+        if (m_markdown && !inFlattenedTable()) {
+            m_writer.markup(QStringLiteral("|"));
+        }
+        return true;
+    case GUMBO_TAG_TD:
+    case GUMBO_TAG_TH:
+        if (inFlattenedTable()) {
+            lineBreak();
+        } else if (!m_tables.isEmpty()) {
+            if (m_markdown) {
+                m_writer.closingMarkup(QStringLiteral(" "));
+            } else if (m_tables.last().cells > 0) {
+                m_writer.discardSpace();
+                m_writer.closingMarkup(QStringLiteral("\t"));
+            }
+            m_tables.last().cells++;
+        }
+        m_cellDepth++;
+        return true;
+    default:
+        if (isBlockElement(tag)) {
+            lineBreak();
+        }
+        return true;
+    }
+}
+
+void Serializer::leaveElement(Element *element)
+{
+    const int tag = element->gumboTag();
+    switch (tag) {
+    case GUMBO_TAG_H1:
+    case GUMBO_TAG_H2:
+    case GUMBO_TAG_H3:
+    case GUMBO_TAG_H4:
+    case GUMBO_TAG_H5:
+    case GUMBO_TAG_H6:
+    case GUMBO_TAG_P:
+        blockBreak();
+        break;
+    case GUMBO_TAG_PRE:
+        m_preDepth--;
+        if (m_markdown) {
+            m_writer.lineBreak();
+            m_writer.markup(QStringLiteral("```"));
+        }
+        blockBreak();
+        break;
+    case GUMBO_TAG_CODE:
+        m_codeDepth--;
+        if (m_markdown && m_preDepth == 0) {
+            m_writer.closingMarkup(QStringLiteral("`"));
+        }
+        break;
+    case GUMBO_TAG_B:
+    case GUMBO_TAG_STRONG:
+        if (m_markdown) {
+            m_writer.closingMarkup(QStringLiteral("**"));
+        }
+        break;
+    case GUMBO_TAG_I:
+    case GUMBO_TAG_EM:
+        if (m_markdown) {
+            m_writer.closingMarkup(QStringLiteral("*"));
+        }
+        break;
+    case GUMBO_TAG_A: {
+        QString href = element->getAttribute("href");
+        if (m_markdown && !href.isEmpty()) {
+            m_writer.closingMarkup(QStringLiteral("](") + href + ')');
+        }
+        break;
+    }
+    case GUMBO_TAG_UL:
+    case GUMBO_TAG_OL:
+        if (!m_lists.isEmpty()) {
+            m_lists.removeLast();
+        }
+        if (m_lists.isEmpty()) {
+            blockBreak();
+        } else {
+            lineBreak();
+        }
+        break;
+    case GUMBO_TAG_LI:
+        if (!m_listPrefixLengths.isEmpty()) {
+            m_writer.popPrefix(m_listPrefixLengths.takeLast());
+        }
+        lineBreak();
+        break;
+    case GUMBO_TAG_BLOCKQUOTE:
+        if (m_markdown && m_cellDepth == 0) {
+            m_writer.popPrefix(2);
+        }
+        blockBreak();
+        break;
+    case GUMBO_TAG_TABLE:
+        if (!m_tables.isEmpty()) {
+            m_tables.removeLast();
+        }
+        blockBreak();
+        break;
+    case GUMBO_TAG_TR:
+        if (m_markdown && !m_tables.isEmpty() && !m_tables.last().flattened && m_tables.last().rows++ == 0) {
+            // Markdown tables need a separator after the header row
+            m_writer.lineBreak();
+            m_writer.markup(QStringLiteral("|") + QStringLiteral(" --- |").repeated(m_tables.last().cells));
+        }
+        lineBreak();
+        break;
+    case GUMBO_TAG_TD:
+    case GUMBO_TAG_TH:
+        m_cellDepth--;
+        if (m_markdown && !m_tables.isEmpty() && !m_tables.last().flattened) {
+            m_writer.discardSpace();
+            m_writer.closingMarkup(QStringLiteral(" |"));
+        }
+        break;
+    default:
+        if (isBlockElement(tag)) {
+            lineBreak();
+        }
+        break;
+    }
+}
+
+QString TextSerializer::toPlainText(Node *root)
+{
+    return Serializer(false).run(root);
+}
+
+QString TextSerializer::toMarkdown(Node *root)
+{
+    return Serializer(true).run(root);
+}
@@ -0,0 +1,25 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QString>
+
+namespace QReadable {
+namespace DomSupport {
+class Node;
+}
+
+/**
+ * Converts a DOM subtree to plain text or Markdown
+ *
+ * Unlike textContent, block-level elements are separated by line
+ * breaks and whitespace is collapsed the way a browser would render
+ * it (except inside <pre>).
+ */
+namespace TextSerializer {
+QString toPlainText(DomSupport::Node *root);
+QString toMarkdown(DomSupport::Node *root);
+}
+}
@@ -0,0 +1,310 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "warcreader.h"
+#include <QIODevice>
+#include <limits>
+#include <zlib.h>
+using namespace QReadable;
+
+// how much to read from the device at a time
+static constexpr qint64 kChunkSize = 256 * 1024;
+
+// zlib window bits that accept either a gzip or a zlib header
+static constexpr int kAutoDetectWindowBits = 15 + 32;
+
+struct WarcReader::PrivData {
+    QIODevice *device;
+    QByteArray buffer;
+    int pos{0};
+    bool detected{false};
+    bool compressed{false};
+    bool inMember{false};
+    z_stream stream{};
+    QString error;
+
+    bool fill();
+    bool inflateChunk(const QByteArray &raw);
+    bool readLine(QByteArray &line);
+    bool readBytes(qint64 length, QByteArray &out);
+};
+
+// Append more decoded input to the buffer.  Returns false at the end of input.
+bool WarcReader::PrivData::fill()
+{
+    if (pos > 0 && pos >= buffer.size() / 2) {
+        buffer.remove(0, pos);
+        pos = 0;
+    }
+
+    QByteArray raw = device->read(kChunkSize);
+    if (raw.isEmpty()) {
+        if (inMember) {
+            error = QStringLiteral("unexpected end of compressed data");
+        }
+        return false;
+    }
+
+    if (!detected) {
+        while (raw.size() < 2 && !device->atEnd()) {
+            QByteArray more = device->read(kChunkSize);
+            if (more.isEmpty()) {
+                break;
+            }
+            raw += more;
+        }
+        detected = true;
+        compressed = raw.startsWith("\x1f\x8b");
+        if (compressed && inflateInit2(&stream, kAutoDetectWindowBits) != Z_OK) {
+            error = QStringLiteral("could not initialize zlib");
+            return false;
+        }
+    }
+
+    if (!compressed) {
+        buffer += raw;
+        return true;
+    }
+    return inflateChunk(raw);
+}
+
+bool WarcReader::PrivData::inflateChunk(const QByteArray &raw)
+{
+    char out[64 * 1024];
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(raw.constData()));
+    stream.avail_in = static_cast<uInt>(raw.size());
+    do {
+        stream.next_out = reinterpret_cast<Bytef *>(out);
+        stream.avail_out = sizeof(out);
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        buffer.append(out, static_cast<int>(sizeof(out) - stream.avail_out));
+        if (ret == Z_STREAM_END) {
+            // WARC.gz files are a series of gzip members, usually one per record
+            inflateReset(&stream);
+            inMember = false;
+        } else if (ret == Z_OK) {
+            inMember = true;
+        } else if (ret != Z_BUF_ERROR) {
+            error = QStringLiteral("corrupt compressed data");
+            return false;
+        }
+    } while (stream.avail_in > 0 || stream.avail_out == 0);
+    return true;
+}
+
+// Read a line, without its line ending.  Returns false at the end of input.
+bool WarcReader::PrivData::readLine(QByteArray &line)
+{
+    // bytes after pos already known not to contain a newline
+    int scanned = 0;
+    while (true) {
+        int newline = buffer.indexOf('\n', pos + scanned);
+        if (newline >= 0) {
+            int end = newline > pos && buffer.at(newline - 1) == '\r' ? newline - 1 : newline;
+            line = buffer.mid(pos, end - pos);
+            pos = newline + 1;
+            return true;
+        }
+        scanned = buffer.size() - pos;
+        if (!fill()) {
+            if (pos < buffer.size()) {
+                line = buffer.mid(pos);
+                pos = buffer.size();
+                return true;
+            }
+            return false;
+        }
+    }
+}
+
+bool WarcReader::PrivData::readBytes(qint64 length, QByteArray &out)
+{
+    while (buffer.size() - pos < length) {
+        if (!fill()) {
+            return false;
+        }
+    }
+    out = buffer.mid(pos, static_cast<int>(length));
+    pos += static_cast<int>(length);
+    return true;
+}
+
+WarcReader::WarcReader(QIODevice *device)
+    : d{std::make_unique<PrivData>()}
+{
+    d->device = device;
+}
+
+WarcReader::~WarcReader()
+{
+    if (d->compressed) {
+        inflateEnd(&d->stream);
+    }
+}
+
+bool WarcReader::readRecord(WarcRecord &record)
+{
+    if (!d->error.isEmpty()) {
+        return false;
+    }
+
+    QByteArray line;
+    do {
+        if (!d->readLine(line)) {
+            return false;
+        }
+    } while (line.isEmpty());
+
+    if (!line.startsWith("WARC/")) {
+        d->error = QStringLiteral("expected a WARC record, found: %1").arg(QString::fromLatin1(line.left(64)));
+        return false;
+    }
+
+    record.headers.clear();
+    while (true) {
+        if (!d->readLine(line)) {
+            d->error = QStringLiteral("unexpected end of input in record header");
+            return false;
+        }
+        if (line.isEmpty()) {
+            break;
+        }
+        int colon = line.indexOf(':');
+        if (colon > 0) {
+            record.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+        }
+    }
+
+    bool ok;
+    qint64 length = record.header("Content-Length").toLongLong(&ok);
+    if (!ok || length < 0 || length > std::numeric_limits<int>::max()) {
+        d->error = QStringLiteral("record has an invalid Content-Length");
+        return false;
+    }
+    if (!d->readBytes(length, record.block)) {
+        if (d->error.isEmpty()) {
+            d->error = QStringLiteral("unexpected end of input in record block");
+        }
+        return false;
+    }
+    return true;
+}
+
+QString WarcReader::errorString() const
+{
+    return d->error;
+}
+
+static bool decodeChunked(const QByteArray &data, QByteArray &out)
+{
+    out.clear();
+    // chunk sizes come from the archive, so keep offsets 64-bit to stay clear of overflow
+    qint64 pos = 0;
+    while (true) {
+        int lineEnd = data.indexOf("\r\n", static_cast<int>(pos));
+        if (lineEnd < 0) {
+            return false;
+        }
+        QByteArray sizeField = data.mid(static_cast<int>(pos), lineEnd - static_cast<int>(pos));
+        int extension = sizeField.indexOf(';');
+        if (extension >= 0) {
+            sizeField.truncate(extension);
+        }
+        bool ok;
+        qint64 size = sizeField.trimmed().toLongLong(&ok, 16);
+        if (!ok || size < 0) {
+            return false;
+        }
+        pos = lineEnd + 2;
+        if (size == 0) {
+            return true;
+        }
+        if (size > data.size() - pos) {
+            // tolerate a truncated final chunk
+            out += data.mid(static_cast<int>(pos));
+            return true;
+        }
+        out += data.mid(static_cast<int>(pos), static_cast<int>(size));
+        pos += size + 2;
+    }
+}
+
+static bool inflateAll(const QByteArray &data, int windowBits, QByteArray &out)
+{
+    z_stream stream{};
+    if (inflateInit2(&stream, windowBits) != Z_OK) {
+        return false;
+    }
+    out.clear();
+    char buffer[64 * 1024];
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    int ret;
+    do {
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, static_cast<int>(sizeof(buffer) - stream.avail_out));
+    } while (ret == Z_OK);
+    inflateEnd(&stream);
+    // a truncated stream still yields whatever could be decoded
+    return ret == Z_STREAM_END || (ret == Z_BUF_ERROR && !out.isEmpty());
+}
+
+bool WarcReader::parseHttpResponse(const QByteArray &block, QByteArray &contentType, QByteArray &body)
+{
+    if (!block.startsWith("HTTP/")) {
+        return false;
+    }
+    int headerEnd = block.indexOf("\r\n\r\n");
+    int separatorLength = 4;
+    if (headerEnd < 0) {
+        headerEnd = block.indexOf("\n\n");
+        separatorLength = 2;
+    }
+    if (headerEnd < 0) {
+        return false;
+    }
+
+    QByteArray transferEncoding;
+    QByteArray contentEncoding;
+    contentType.clear();
+    const QList<QByteArray> lines = block.left(headerEnd).split('\n');
+    for (int i = 1; i < lines.size(); i++) {
+        const QByteArray &line = lines.at(i);
+        int colon = line.indexOf(':');
+        if (colon <= 0) {
+            continue;
+        }
+        QByteArray name = line.left(colon).trimmed().toLower();
+        if (name == "content-type") {
+            contentType = line.mid(colon + 1).trimmed();
+        } else if (name == "transfer-encoding") {
+            transferEncoding = line.mid(colon + 1).trimmed().toLower();
+        } else if (name == "content-encoding") {
+            contentEncoding = line.mid(colon + 1).trimmed().toLower();
+        }
+    }
+
+    body = block.mid(headerEnd + separatorLength);
+    if (transferEncoding.contains("chunked")) {
+        QByteArray decoded;
+        if (!decodeChunked(body, decoded)) {
+            return false;
+        }
+        body = decoded;
+    }
+    if (contentEncoding == "gzip" || contentEncoding == "x-gzip" || contentEncoding == "deflate") {
+        QByteArray decoded;
+        // some servers send raw deflate data for "deflate", so fall back to that
+        if (!inflateAll(body, kAutoDetectWindowBits, decoded) &&
+                (contentEncoding != "deflate" || !inflateAll(body, -15, decoded))) {
+            return false;
+        }
+        body = decoded;
+    } else if (!contentEncoding.isEmpty() && contentEncoding != "identity") {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <memory>
+
+class QIODevice;
+
+namespace QReadable {
+/**
+ * A single record from a WARC file
+ */
+struct WarcRecord {
+    /** The WARC header fields, keyed by lower-case name */
+    QHash<QByteArray, QByteArray> headers;
+
+    /** The record's content block */
+    QByteArray block;
+
+    QByteArray header(const QByteArray &name) const
+    {
+        return headers.value(name.toLower());
+    }
+};
+
+/**
+ * Reads the records of a WARC file sequentially from a QIODevice
+ *
+ * Gzip-compressed WARC files (one or more concatenated gzip members) are
+ * detected and decompressed on the fly, so the device is read once from
+ * start to finish and only the current record is held in memory.
+ */
+class WarcReader
+{
+public:
+    explicit WarcReader(QIODevice *device);
+    ~WarcReader();
+    WarcReader(WarcReader &other) = delete;
+    void operator=(WarcReader &other) = delete;
+
+    /**
+     * Read the next record into \a record
+     *
+     * Returns false at the end of the input, or if the input is not a
+     * well formed WARC file, in which case errorString() is set.
+     */
+    bool readRecord(WarcRecord &record);
+
+    /**
+     * A description of the last error, or an empty string if there was none
+     */
+    QString errorString() const;
+
+    /**
+     * Split the HTTP response in a response record's \a block into its
+     * Content-Type and its body, undoing any chunked transfer encoding and
+     * gzip or deflate content encoding.
+     *
+     * Returns false if \a block is not an HTTP response or can't be decoded.
+     */
+    static bool parseHttpResponse(const QByteArray &block, QByteArray &contentType, QByteArray &body);
+
+private:
+    struct PrivData;
+    std::unique_ptr<PrivData> d;
+};
+}
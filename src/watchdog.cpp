@@ -0,0 +1,126 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "watchdog.h"
+#include <QJSEngine>
+using namespace QReadable;
+
+// The token state doubles as the wakeup channel for any watchdogs waiting on it
+struct CancellationToken::State {
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool cancelled{false};
+};
+
+CancellationToken::CancellationToken()
+    : d{std::make_shared<State>()}
+{
+}
+
+CancellationToken::~CancellationToken() = default;
+
+void CancellationToken::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->cancelled = true;
+    }
+    d->wakeup.notify_all();
+}
+
+bool CancellationToken::isCancelled() const
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->cancelled;
+}
+
+Watchdog::Watchdog(QJSEngine *engine)
+    : m_engine{engine}
+    , m_thread{&Watchdog::run, this}
+{
+}
+
+Watchdog::~Watchdog()
+{
+    disarm();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+void Watchdog::arm(const CancellationToken &token, Clock::time_point deadline)
+{
+    disarm();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_token = token;
+        m_deadline = deadline;
+        m_status = Article::Complete;
+        m_armed = true;
+        m_requested = true;
+    }
+    m_changed.notify_all();
+}
+
+void Watchdog::disarm()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_armed) {
+        return;
+    }
+    m_armed = false;
+    m_requested = false;
+    CancellationToken token = m_token;
+    lock.unlock();
+    {
+        // taking the token's lock means the watch has either seen m_armed or is waiting for this
+        std::lock_guard<std::mutex> tokenLock(token.d->mutex);
+    }
+    token.d->wakeup.notify_all();
+    lock.lock();
+    m_changed.wait(lock, [this]{ return !m_watching; });
+    if (hasFired()) {
+        m_engine->setInterrupted(false);
+    }
+}
+
+void Watchdog::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_changed.wait(lock, [this]{ return m_requested || m_shutdown; });
+        if (m_shutdown) {
+            return;
+        }
+        m_requested = false;
+        m_watching = true;
+        CancellationToken token = m_token;
+        Clock::time_point deadline = m_deadline;
+        lock.unlock();
+        watch(token, deadline);
+        lock.lock();
+        m_watching = false;
+        m_changed.notify_all();
+    }
+}
+
+void Watchdog::watch(const CancellationToken &token, Clock::time_point deadline)
+{
+    CancellationToken::State &state = *token.d;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    auto isDone = [this, &state]{
+        return !m_armed || state.cancelled;
+    };
+    bool done = deadline == Clock::time_point::max() ?
+                (state.wakeup.wait(lock, isDone), true) :
+                state.wakeup.wait_until(lock, deadline, isDone);
+    if (!m_armed) {
+        return;
+    }
+    m_status = done ? Article::Cancelled : Article::TimedOut;
+    m_engine->setInterrupted(true);
+}
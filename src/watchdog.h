@@ -0,0 +1,78 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "article.h"
+#include "parselimits.h"
+class QJSEngine;
+
+namespace QReadable {
+/**
+ * Interrupts a script engine when a deadline passes or a token is cancelled
+ *
+ * The watchdog keeps one thread for its whole lifetime, which sleeps until
+ * arm() starts watching a token and deadline, and goes back to sleep on
+ * disarm().  When it fires it calls QJSEngine::setInterrupted(), and
+ * hasFired() starts returning true so that native code can poll it.
+ */
+class Watchdog
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Watchdog(QJSEngine *engine);
+    ~Watchdog();
+    Watchdog(Watchdog &other) = delete;
+    void operator=(Watchdog &other) = delete;
+
+    /**
+     * Start watching \a token and \a deadline, until disarm() is called
+     */
+    void arm(const CancellationToken &token, Clock::time_point deadline=Clock::time_point::max());
+
+    /**
+     * Stop watching and clear the engine's interrupted flag
+     *
+     * The watchdog does not fire after this returns.
+     */
+    void disarm();
+
+    /**
+     * True once the deadline has passed or the token has been cancelled
+     */
+    bool hasFired() const
+    {
+        return m_status.load(std::memory_order_relaxed) != Article::Complete;
+    }
+
+    /**
+     * Why the watchdog fired, or Article::Complete if it did not
+     */
+    Article::Status status() const
+    {
+        return m_status.load();
+    }
+
+private:
+    QJSEngine *m_engine;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    CancellationToken m_token;
+    Clock::time_point m_deadline;
+    bool m_requested{false};
+    bool m_watching{false};
+    bool m_shutdown{false};
+    std::atomic<bool> m_armed{false};
+    std::atomic<Article::Status> m_status{Article::Complete};
+    std::thread m_thread;
+    void run();
+    void watch(const CancellationToken &token, Clock::time_point deadline);
+};
+}
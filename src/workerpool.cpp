@@ -0,0 +1,204 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "workerpool.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMetaEnum>
+#include <QThread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+using namespace QReadable;
+
+// how many jobs may wait in the queue for each worker
+static constexpr int kQueueDepthPerWorker = 4;
+
+struct WorkerPool::PrivData {
+    ReadableOptions options;
+    ResultHandler handler;
+    std::shared_ptr<ResultCache> cache;
+    std::vector<std::unique_ptr<QThread>> threads;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable spaceAvailable;
+    std::deque<ExtractionJob> queue;
+    size_t maxQueueLength{0};
+    bool finishing{false};
+    std::atomic<bool> profileNativeCalls{false};
+    mutable std::mutex profileMutex;
+    NativeCallTable nativeCalls;
+
+    void runWorker();
+    bool takeJob(ExtractionJob &job);
+};
+
+static double elapsedMs(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+WorkerPool::WorkerPool(int workers, const ReadableOptions &options, ResultHandler handler, std::shared_ptr<ResultCache> cache)
+    : d{std::make_unique<PrivData>()}
+{
+    d->options = options;
+    d->handler = std::move(handler);
+    d->cache = std::move(cache);
+    workers = qMax(1, workers);
+    d->maxQueueLength = workers * kQueueDepthPerWorker;
+    for (int i=0; i<workers; i++) {
+        std::unique_ptr<QThread> thread(QThread::create([this]{ d->runWorker(); }));
+        thread->start();
+        d->threads.push_back(std::move(thread));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    finish();
+}
+
+void WorkerPool::submit(ExtractionJob job)
+{
+    std::unique_lock<std::mutex> lock(d->mutex);
+    d->spaceAvailable.wait(lock, [this]{ return d->queue.size() < d->maxQueueLength; });
+    d->queue.push_back(std::move(job));
+    lock.unlock();
+    d->jobAvailable.notify_one();
+}
+
+int WorkerPool::queueCapacity() const
+{
+    return static_cast<int>(d->maxQueueLength);
+}
+
+void WorkerPool::setProfileNativeCalls(bool profile)
+{
+    d->profileNativeCalls = profile;
+}
+
+NativeCallTable WorkerPool::nativeCallProfile() const
+{
+    std::lock_guard<std::mutex> lock(d->profileMutex);
+    return d->nativeCalls;
+}
+
+void WorkerPool::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->finishing = true;
+    }
+    d->jobAvailable.notify_all();
+    for (auto &thread : d->threads) {
+        thread->wait();
+    }
+    d->threads.clear();
+}
+
+bool WorkerPool::PrivData::takeJob(ExtractionJob &job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobAvailable.wait(lock, [this]{ return !queue.empty() || finishing; });
+    if (queue.empty()) {
+        return false;
+    }
+    job = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+    spaceAvailable.notify_one();
+    return true;
+}
+
+void WorkerPool::PrivData::runWorker()
+{
+    Readable readable(options);
+    readable.setResultCache(cache);
+    ExtractionJob job;
+    while (takeJob(job)) {
+        bool profile = profileNativeCalls;
+        if (profile != readable.profilesNativeCalls()) {
+            readable.setProfileNativeCalls(profile);
+        }
+        QElapsedTimer timer;
+        timer.start();
+        const ResultHandler &deliver = job.onResult ? job.onResult : handler;
+        QJsonObject record = job.fields;
+        QJsonObject timings;
+        if (!job.path.isEmpty()) {
+            record.insert("path", job.path);
+        }
+        record.insert("url", job.url.toString());
+
+        Article article;
+        if (job.source == ExtractionJob::Source::File) {
+            // parsed straight out of a memory mapping
+            article = readable.parseFile(job.path, job.url, job.options.value_or(options), job.limits);
+            if (article.status() == Article::ReadError) {
+                record.insert("error", QStringLiteral("could not read %1").arg(job.path));
+                deliver(record);
+                continue;
+            }
+            record.insert("inputBytes", QFileInfo(job.path).size());
+        } else {
+            record.insert("inputBytes", job.html.size());
+            article = readable.parse(job.html, job.url, job.options.value_or(options), job.limits);
+            job.html.clear();
+        }
+        timings.insert("parseMs", elapsedMs(timer));
+        if (profile) {
+            const NativeCallTable calls = readable.lastParseStats().nativeCalls;
+            std::lock_guard<std::mutex> lock(profileMutex);
+            for (auto it = calls.cbegin(); it != calls.cend(); ++it) {
+                nativeCalls[it.key()] += it.value();
+            }
+        }
+
+        const QJsonObject articleFields = articleRecord(article);
+        for (auto it = articleFields.begin(); it != articleFields.end(); ++it) {
+            record.insert(it.key(), it.value());
+        }
+        record.insert("timings", timings);
+        deliver(record);
+    }
+}
+
+bool QReadable::parseOutputFormat(const QString &name, OutputFormat &format)
+{
+    if (name == QLatin1String("html")) {
+        format = OutputFormat::Html;
+    } else if (name == QLatin1String("text")) {
+        format = OutputFormat::PlainText;
+    } else if (name == QLatin1String("markdown")) {
+        format = OutputFormat::Markdown;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QJsonObject WorkerPool::articleRecord(const Article &article)
+{
+    QJsonObject record;
+    const char *status = QMetaEnum::fromType<Article::Status>().valueToKey(article.status());
+    record.insert("status", QString::fromLatin1(status).toLower());
+    record.insert("found", !article.isNull());
+    if (article.isNull()) {
+        return record;
+    }
+    auto nullable = [](const QString &value) {
+        return value.isNull() ? QJsonValue(QJsonValue::Null) : QJsonValue(value);
+    };
+    record.insert("title", nullable(article.title()));
+    record.insert("byline", nullable(article.byline()));
+    record.insert("dir", nullable(article.dir()));
+    record.insert("lang", nullable(article.lang()));
+    record.insert("excerpt", nullable(article.excerpt()));
+    record.insert("siteName", nullable(article.siteName()));
+    record.insert("length", article.length());
+    record.insert("content", nullable(article.content()));
+    record.insert("textContent", nullable(article.textContent()));
+    return record;
+}
@@ -0,0 +1,114 @@
+/**
+ * SPDX-FileCopyrightText: 2022 Connor Carney <hello@connorcarney.com>
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QUrl>
+#include <functional>
+#include <memory>
+#include <optional>
+#include "readable.h"
+#include "resultcache.h"
+
+namespace QReadable {
+/**
+ * Parse an output format name (html, text or markdown) into \a format
+ */
+bool parseOutputFormat(const QString &name, OutputFormat &format);
+
+/**
+ * A document to be extracted by a WorkerPool
+ */
+struct ExtractionJob {
+    enum class Source {
+        Html,   ///< the document is in html
+        File    ///< the document is read from the file at path
+    };
+
+    /** Where the document comes from */
+    Source source{Source::Html};
+
+    /** The file the document was read from, if any */
+    QString path;
+
+    /** The UTF-8 encoded HTML of the document */
+    QByteArray html;
+
+    /** The URL the document was loaded from */
+    QUrl url;
+
+    /** Extra fields copied into the result record */
+    QJsonObject fields;
+
+    /** Options to use instead of the pool's */
+    std::optional<ReadableOptions> options;
+
+    /** Budgets for parsing html */
+    ParseLimits limits;
+
+    /** Called with the result instead of the pool's result handler, if set */
+    std::function<void(const QJsonObject &record)> onResult;
+};
+
+/**
+ * Runs extraction jobs on a fixed set of worker threads
+ *
+ * Each worker owns one Readable, so the cost of starting a script
+ * engine and compiling Readability.js is paid once per worker rather
+ * than once per document.  Results are delivered as JSON records (the
+ * job's fields plus every Article field and timings) to the result
+ * handler, which is called on the worker threads.
+ */
+class WorkerPool
+{
+public:
+    using ResultHandler = std::function<void(const QJsonObject &record)>;
+
+    /**
+     * Start \a workers workers, whose Readables share \a cache if it is set
+     */
+    WorkerPool(int workers, const ReadableOptions &options, ResultHandler handler, std::shared_ptr<ResultCache> cache=nullptr);
+    ~WorkerPool();
+    WorkerPool(WorkerPool &other) = delete;
+    void operator=(WorkerPool &other) = delete;
+
+    /**
+     * Queue a job, blocking while the queue is full
+     */
+    void submit(ExtractionJob job);
+
+    /**
+     * How many jobs can be queued before submit() blocks
+     */
+    int queueCapacity() const;
+
+    /**
+     * Profile the calls Readability.js makes into the DOM for the jobs that follow
+     *
+     * \sa Readable::setProfileNativeCalls()
+     */
+    void setProfileNativeCalls(bool profile);
+
+    /**
+     * The native calls profiled so far, summed over every worker
+     */
+    NativeCallTable nativeCallProfile() const;
+
+    /**
+     * Wait for all queued jobs to finish and stop the workers
+     */
+    void finish();
+
+    /**
+     * Build the result record for an extracted article
+     */
+    static QJsonObject articleRecord(const Article &article);
+
+private:
+    struct PrivData;
+    std::unique_ptr<PrivData> d;
+};
+}
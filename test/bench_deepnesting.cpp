@@ -0,0 +1,108 @@
+#include <QtTest>
+#include <QThread>
+#include <functional>
+
+#include "domsupport.h"
+
+using namespace QReadable;
+
+// every depth runs on a stack this small, which recursion once per level would overflow
+static constexpr uint kStackBytes = 512 * 1024;
+
+/**
+ * Times tree algorithms on a single chain of nested elements, up to a million deep
+ *
+ * Each phase should take time linear in the depth (a constant ns/level)
+ * and run on a small, fixed-size stack.  The tree is built with
+ * appendChild() rather than parsed, since Gumbo's own tree construction
+ * is not linear in the nesting depth.
+ */
+class benchDeepNesting : public QObject
+{
+    Q_OBJECT
+
+    // run phase on a thread with a small stack, returning its duration in ns
+    static qint64 onSmallStack(const std::function<void()> &phase)
+    {
+        qint64 nsecs = -1;
+        std::unique_ptr<QThread> thread(QThread::create([&phase, &nsecs]{
+            QElapsedTimer timer;
+            timer.start();
+            phase();
+            nsecs = timer.nsecsElapsed();
+        }));
+        thread->setStackSize(kStackBytes);
+        thread->start();
+        thread->wait();
+        return nsecs;
+    }
+
+    static DomSupport::Element *buildChain(int depth)
+    {
+        auto *root = new DomSupport::Element("div");
+        DomSupport::Node *innermost = root;
+        for (int i = 0; i < depth; i++) {
+            auto *child = new DomSupport::Element(i % 2 ? "div" : "font");
+            innermost->appendChild(child);
+            innermost = child;
+        }
+        auto *text = new DomSupport::Text();
+        text->setTextContent("deep");
+        innermost->appendChild(text);
+        return root;
+    }
+
+    static void report(const char *phase, int depth, qint64 nsecs)
+    {
+        qInfo().noquote() << QStringLiteral("%1 at depth %2: %3 ms, %4 ns/level")
+                             .arg(QLatin1String(phase)).arg(depth)
+                             .arg(nsecs / 1e6, 0, 'f', 2)
+                             .arg(double(nsecs) / depth, 0, 'f', 1);
+    }
+
+private slots:
+    void benchNesting_data()
+    {
+        QTest::addColumn<int>("depth");
+        for (int depth = 1000; depth <= 1000000; depth *= 10) {
+            QTest::newRow(qPrintable(QString::number(depth))) << depth;
+        }
+    }
+
+    void benchNesting()
+    {
+        QFETCH(int, depth);
+        DomSupport::Element *root = nullptr;
+        qint64 total = 0;
+        qint64 nsecs = onSmallStack([&]{ root = buildChain(depth); });
+        report("build", depth, nsecs);
+        total += nsecs;
+
+        QString html;
+        nsecs = onSmallStack([&]{ html = root->innerHTML(); });
+        QVERIFY(nsecs >= 0);
+        QVERIFY(html.endsWith("</font>"));
+        report("innerHTML", depth, nsecs);
+        total += nsecs;
+
+        QString text;
+        nsecs = onSmallStack([&]{ text = root->textContent(); });
+        QCOMPARE(text, QStringLiteral("deep"));
+        report("textContent", depth, nsecs);
+        total += nsecs;
+
+        nsecs = onSmallStack([&]{ root->clear(); });
+        report("clear", depth, nsecs);
+        total += nsecs;
+
+        nsecs = onSmallStack([&]{ delete root; });
+        QVERIFY(nsecs >= 0);
+        report("destroy", depth, nsecs);
+        total += nsecs;
+
+        QTest::setBenchmarkResult(total / 1e6, QTest::WalltimeMilliseconds);
+    }
+};
+
+QTEST_MAIN(benchDeepNesting)
+#include "bench_deepnesting.moc"
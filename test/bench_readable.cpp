@@ -0,0 +1,313 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQmlEngine>
+#include <atomic>
+#include <sys/resource.h>
+
+#include "dombuilder.h"
+#include "jshelpers.h"
+#include "readable.h"
+
+using namespace QReadable;
+
+static constexpr const char *kTestUrl = "http://fakehost/test/page.html";
+
+// phases measured without QBENCHMARK run at least this many times, and for at least this long
+static constexpr int kMinIterations = 3;
+static constexpr qint64 kMinNsecs = 100 * 1000 * 1000;
+
+// Count every heap allocation, whichever library makes it
+static std::atomic<quint64> allocationCount{0};
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+}
+#endif
+
+/**
+ * Accumulates the time and allocations of the measured part of each iteration
+ */
+struct Measurement {
+    qint64 nsecs{0};
+    quint64 allocations{0};
+    int iterations{0};
+    QElapsedTimer timer;
+    quint64 allocationsAtStart{0};
+
+    void start()
+    {
+        allocationsAtStart = allocationCount.load(std::memory_order_relaxed);
+        timer.start();
+    }
+
+    void stop()
+    {
+        nsecs += timer.nsecsElapsed();
+        allocations += allocationCount.load(std::memory_order_relaxed) - allocationsAtStart;
+        iterations++;
+    }
+
+    bool done() const
+    {
+        return iterations >= kMinIterations && nsecs >= kMinNsecs;
+    }
+};
+
+struct PhaseTotals {
+    double nsecs{0};
+    double allocations{0};
+    qint64 bytes{0};
+    int pages{0};
+};
+
+/**
+ * Times Readable over the Readability.js test-pages corpus, end to end and per phase
+ *
+ * Results are printed by QtTest and written as JSON to the file named by
+ * QREADABLE_BENCH_JSON (benchReadable.json by default).
+ */
+class benchReadable : public QObject
+{
+    Q_OBJECT
+
+    QDir m_pagesDir{QStringLiteral(QREADABLE_TEST_PAGES_DIR)};
+    QHash<QString, QByteArray> m_sources;
+    std::unique_ptr<Readable> m_readable;
+    std::unique_ptr<QQmlEngine> m_engine;
+    QJSValue m_jsOptions;
+    QJsonObject m_pageResults;
+    QMap<QString, PhaseTotals> m_totals;
+
+    void addPageRows()
+    {
+        QTest::addColumn<QString>("page");
+        for (const QString &page : m_pagesDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            QTest::newRow(qPrintable(page)) << page;
+        }
+    }
+
+    QByteArray source(const QString &page)
+    {
+        auto found = m_sources.find(page);
+        if (found == m_sources.end()) {
+            QFile file(m_pagesDir.filePath(page + "/source.html"));
+            file.open(QFile::ReadOnly);
+            found = m_sources.insert(page, file.readAll());
+        }
+        return found.value();
+    }
+
+    void record(const QString &page, const QString &phase, const Measurement &measurement)
+    {
+        double nsecs = double(measurement.nsecs) / measurement.iterations;
+        double allocations = double(measurement.allocations) / measurement.iterations;
+        qint64 bytes = source(page).size();
+
+        QJsonObject pageResult = m_pageResults.value(page).toObject();
+        pageResult.insert("bytes", bytes);
+        pageResult.insert(phase, QJsonObject{
+                              {"ms", nsecs / 1e6},
+                              {"allocations", allocations},
+                              {"mbPerSecond", bytes / nsecs * 1e9 / (1024 * 1024)}});
+        m_pageResults.insert(page, pageResult);
+
+        PhaseTotals &totals = m_totals[phase];
+        totals.nsecs += nsecs;
+        totals.allocations += allocations;
+        totals.bytes += bytes;
+        totals.pages++;
+    }
+
+    // Build the document for page, outside of any measurement
+    DomSupport::Document *buildDocument(const QString &page)
+    {
+        DomBuilder builder(source(page));
+        DomSupport::Document *document = builder.buildDocument(QUrl(kTestUrl));
+        QQmlEngine::setObjectOwnership(document, QQmlEngine::CppOwnership);
+        return document;
+    }
+
+    // Run Readability.js on document, returning the article node instead of its HTML
+    QJSValue extract(DomSupport::Document *document)
+    {
+        QJSValue jsThis = m_engine->globalObject();
+        QJSValue readability = JSHelpers::callMemberConstructor(jsThis, "Readability", {m_engine->newQObject(document), m_jsOptions});
+        return JSHelpers::callMember(readability, "parse");
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(m_pagesDir.exists());
+        m_readable = std::make_unique<Readable>();
+        m_engine = std::make_unique<QQmlEngine>();
+        m_engine->installExtensions(QJSEngine::ConsoleExtension);
+        JSHelpers::evalFile(*m_engine, ":/Readability.js");
+        m_jsOptions = m_engine->evaluate("({serializer: function(el) { return el; }})");
+    }
+
+    void cleanupTestCase()
+    {
+        QJsonObject totals;
+        for (auto it = m_totals.cbegin(); it != m_totals.cend(); ++it) {
+            const PhaseTotals &phase = it.value();
+            totals.insert(it.key(), QJsonObject{
+                              {"pages", phase.pages},
+                              {"bytes", phase.bytes},
+                              {"ms", phase.nsecs / 1e6},
+                              {"mbPerSecond", phase.bytes / phase.nsecs * 1e9 / (1024 * 1024)},
+                              {"pagesPerSecond", phase.pages / phase.nsecs * 1e9},
+                              {"allocationsPerPage", phase.allocations / phase.pages}});
+            qInfo().noquote() << QStringLiteral("%1: %2 MB/s, %3 pages/s, %4 allocations/page")
+                                 .arg(it.key())
+                                 .arg(phase.bytes / phase.nsecs * 1e9 / (1024 * 1024), 0, 'f', 2)
+                                 .arg(phase.pages / phase.nsecs * 1e9, 0, 'f', 1)
+                                 .arg(phase.allocations / phase.pages, 0, 'f', 0);
+        }
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        QJsonObject results{
+            {"qtVersion", QString::fromLatin1(qVersion())},
+            {"peakRssKiB", static_cast<qint64>(usage.ru_maxrss)},
+            {"countsAllocations", allocationCount.load() > 0},
+            {"totals", totals},
+            {"pages", m_pageResults}};
+
+        QString path = qEnvironmentVariable("QREADABLE_BENCH_JSON", QStringLiteral("benchReadable.json"));
+        QFile file(path);
+        if (file.open(QFile::WriteOnly)) {
+            file.write(QJsonDocument(results).toJson());
+            qInfo().noquote() << "Wrote" << path;
+        }
+
+        m_engine.reset();
+        m_readable.reset();
+    }
+
+    void benchEndToEnd_data()
+    {
+        addPageRows();
+    }
+
+    void benchEndToEnd()
+    {
+        QFETCH(QString, page);
+        QString html = QString::fromUtf8(source(page));
+        Measurement measurement;
+        QBENCHMARK {
+            measurement.start();
+            m_readable->parse(html, QUrl(kTestUrl));
+            measurement.stop();
+        }
+        record(page, "endToEnd", measurement);
+    }
+
+    void benchGumboParse_data()
+    {
+        addPageRows();
+    }
+
+    void benchGumboParse()
+    {
+        QFETCH(QString, page);
+        QByteArray html = source(page);
+        Measurement measurement;
+        QBENCHMARK {
+            measurement.start();
+            GumboOutput *output = gumbo_parse_with_options(&kGumboDefaultOptions, html.constData(), html.size());
+            gumbo_destroy_output(output);
+            measurement.stop();
+        }
+        record(page, "gumboParse", measurement);
+    }
+
+    void benchDomBuild_data()
+    {
+        addPageRows();
+    }
+
+    void benchDomBuild()
+    {
+        QFETCH(QString, page);
+        QByteArray html = source(page);
+        Measurement measurement;
+        while (!measurement.done()) {
+            DomBuilder builder(html);
+            measurement.start();
+            std::unique_ptr<DomSupport::Document> document(builder.buildDocument(QUrl(kTestUrl)));
+            measurement.stop();
+        }
+        QTest::setBenchmarkResult(measurement.nsecs / 1e6 / measurement.iterations, QTest::WalltimeMilliseconds);
+        record(page, "domBuild", measurement);
+    }
+
+    void benchExtraction_data()
+    {
+        addPageRows();
+    }
+
+    void benchExtraction()
+    {
+        QFETCH(QString, page);
+        Measurement measurement;
+        while (!measurement.done()) {
+            std::unique_ptr<DomSupport::Document> document(buildDocument(page));
+            measurement.start();
+            extract(document.get());
+            measurement.stop();
+        }
+        QTest::setBenchmarkResult(measurement.nsecs / 1e6 / measurement.iterations, QTest::WalltimeMilliseconds);
+        record(page, "extraction", measurement);
+    }
+
+    void benchSerialization_data()
+    {
+        addPageRows();
+    }
+
+    void benchSerialization()
+    {
+        QFETCH(QString, page);
+        std::unique_ptr<DomSupport::Document> document(buildDocument(page));
+        QJSValue result = extract(document.get());
+        auto *article = qobject_cast<DomSupport::AbstractContentNode *>(result.property("content").toQObject());
+        if (!article) {
+            QSKIP("no article");
+        }
+        Measurement measurement;
+        QBENCHMARK {
+            measurement.start();
+            article->innerHTML();
+            measurement.stop();
+        }
+        record(page, "serialization", measurement);
+    }
+};
+
+QTEST_MAIN(benchReadable)
+#include "bench_readable.moc"
@@ -104,6 +104,14 @@ private slots:
         QVERIFY(m_testSupport->didSucceed());
     }
 
+    void testClassifierFlags()
+    {
+        baseDoc(m_engine.get());
+        QJSValue result = m_engine->evaluate(kTestClassifierFlags);
+        QVERIFY(!result.isError());
+        QVERIFY(m_testSupport->didSucceed());
+    }
+
     void testHTMLEscapes()
     {
         DomBuilder builder(kEscapeTestCase);
@@ -127,6 +135,287 @@ private slots:
         QVERIFY(!result.isError());
         QVERIFY(m_testSupport->didSucceed());
     }
+
+    void testDeepNesting()
+    {
+        static constexpr int kDepth = 100000;
+        QString html;
+        QString text;
+        // a stack this small would overflow if anything recursed once per level
+        std::unique_ptr<QThread> thread(QThread::create([&html, &text]{
+            auto *root = new DomSupport::Element("div");
+            DomSupport::Node *innermost = root;
+            for (int i = 0; i < kDepth; i++) {
+                auto *child = new DomSupport::Element("div");
+                innermost->appendChild(child);
+                innermost = child;
+            }
+            auto *textNode = new DomSupport::Text();
+            textNode->setTextContent("x");
+            innermost->appendChild(textNode);
+            html = root->innerHTML();
+            text = root->textContent();
+            delete root;
+        }));
+        thread->setStackSize(256 * 1024);
+        thread->start();
+        QVERIFY(thread->wait(60000));
+        QCOMPARE(text, QStringLiteral("x"));
+        QVERIFY(html.startsWith("<div><div>"));
+        QVERIFY(html.endsWith("</div></div>"));
+        QCOMPARE(html.size(), kDepth * 11 + 1);
+    }
+
+    void testTeardown()
+    {
+        int destroyed = 0;
+        auto *root = new DomSupport::Element("div");
+        QObject::connect(root, &QObject::destroyed, [&destroyed]{ destroyed++; });
+        int created = 1;
+        for (int i = 0; i < 100; i++) {
+            auto *child = new DomSupport::Element("p");
+            child->setAttribute("class", "x");
+            auto *text = new DomSupport::Text();
+            text->setTextContent("text");
+            child->appendChild(text);
+            root->appendChild(child);
+            for (QObject *eachObject : {static_cast<QObject *>(child), static_cast<QObject *>(text), child->children().first()}) {
+                QObject::connect(eachObject, &QObject::destroyed, [&destroyed]{ destroyed++; });
+            }
+            created += 3;
+        }
+        // removed nodes stay owned by the tree
+        root->removeChild(root->firstElementChild());
+        delete root;
+        QCOMPARE(destroyed, created);
+    }
+
+    void testDocumentStructure()
+    {
+        DomBuilder builder(QStringLiteral("<title>One</title><p>text</p>"));
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+        DomSupport::Element *html = doc->documentElement();
+        DomSupport::Element *body = doc->body();
+        QVERIFY(body);
+        QCOMPARE(body->tagName(), QStringLiteral("BODY"));
+        QCOMPARE(doc->head()->tagName(), QStringLiteral("HEAD"));
+        QCOMPARE(doc->title(), QStringLiteral("One"));
+
+        doc->head()->firstElementChild()->setTextContent("Two");
+        QCOMPARE(doc->title(), QStringLiteral("Two"));
+        auto *title = new DomSupport::Element("title");
+        title->setTextContent("Three");
+        doc->head()->replaceChild(title, doc->head()->firstElementChild());
+        QCOMPARE(doc->title(), QStringLiteral("Three"));
+
+        html->removeChild(body);
+        QVERIFY(!doc->body());
+        auto *newBody = new DomSupport::Element("body");
+        html->appendChild(newBody);
+        QCOMPARE(doc->body(), newBody);
+    }
+
+    void testRenameAndMoveChildren()
+    {
+        DomBuilder builder(QStringLiteral("<div id=\"a\">one<b>two</b>three<i>four</i><br>five</div><p id=\"b\">six</p>"));
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+        DomSupport::Element *body = doc->body();
+        DomSupport::Element *div = doc->getElementById("a");
+        DomSupport::Element *p = doc->getElementById("b");
+
+        QCOMPARE(div->renameTag("section"), div);
+        QCOMPARE(div->tagName(), QStringLiteral("SECTION"));
+        QCOMPARE(div->localName(), QStringLiteral("section"));
+        QCOMPARE(div->getAttribute("id"), QStringLiteral("a"));
+        body->renameTag("div");
+        QVERIFY(!doc->body());
+
+        // a node can't be moved into itself
+        div->moveChildrenTo(div->firstElementChild(), div->firstChild(), div->lastChild());
+        QCOMPARE(div->childNodes().size(), 6);
+        // nor can a range that ends before it starts, or outside the node
+        div->moveChildrenTo(p, div->childNodes().at(3), div->childNodes().at(1));
+        div->moveChildrenTo(p, div->firstChild(), p->firstChild());
+        p->moveChildrenTo(div, div->firstChild());
+        QCOMPARE(div->childNodes().size(), 6);
+        QCOMPARE(p->childNodes().size(), 1);
+
+        DomSupport::Node *three = div->childNodes().at(2);
+        DomSupport::Node *br = div->childNodes().at(4);
+        div->moveChildrenTo(p, three, br);
+        QCOMPARE(div->innerHTML(), QStringLiteral("one<b>two</b><br>five"));
+        QCOMPARE(p->innerHTML(), QStringLiteral("sixthree<i>four</i>"));
+        QCOMPARE(static_cast<DomSupport::Node *>(div->firstElementChild()->nextElementSibling()), br);
+        QCOMPARE(br->previousSibling(), div->childNodes().at(1));
+        QVERIFY(!p->lastElementChild()->previousElementSibling());
+        QCOMPARE(three->parentNode(), static_cast<DomSupport::Node *>(p));
+        QCOMPARE(three->previousSibling(), p->firstChild());
+
+        div->moveChildrenTo(p);
+        QVERIFY(div->childNodes().isEmpty());
+        QVERIFY(div->elementChildren().isEmpty());
+        QCOMPARE(p->innerHTML(), QStringLiteral("sixthree<i>four</i>one<b>two</b><br>five"));
+        QCOMPARE(p->elementChildren().size(), 3);
+        QCOMPARE(p->firstElementChild()->nextElementSibling()->tagName(), QStringLiteral("B"));
+    }
+
+    void testTableShape()
+    {
+        DomBuilder builder(QStringLiteral(
+            "<table id=\"layout\"><tr rowspan=\"2\"><td>a<td colspan=\" 2x\"></tr>"
+            "<tr rowspan=\"junk\"><td colspan=\"0\"><td></tr></table>"
+            "<table id=\"summary\" summary=\"s\"><tr><td></table>"
+            "<table id=\"presentation\" role=\"presentation\"><caption>c</caption></table>"));
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+        DomSupport::Element *table = doc->getElementById("layout");
+        QVariantMap shape = table->tableShape();
+        QCOMPARE(shape.value("rows").toInt(), 3);
+        QCOMPARE(shape.value("columns").toInt(), 3);
+        QVERIFY(!shape.value("caption").toBool());
+        QVERIFY(!shape.value("dataDescendants").toBool());
+        QVERIFY(!table->isDataTable());
+        QVERIFY(doc->getElementById("summary")->isDataTable());
+        QVERIFY(!doc->getElementById("presentation")->isDataTable());
+
+        // the cached shape is dropped when the table changes
+        table->getElementsByTagName("td").first()->setAttribute("colspan", "9");
+        QCOMPARE(table->tableShape().value("columns").toInt(), 11);
+        QVERIFY(table->isDataTable());
+        table->getElementsByTagName("td").first()->setAttribute("colspan", "1");
+        table->getElementsByTagName("tr").first()->appendChild(new DomSupport::Element("th"));
+        QVERIFY(table->tableShape().value("dataDescendants").toBool());
+    }
+
+    void testAttributeCleanup()
+    {
+        DomBuilder builder(QStringLiteral(
+            "<div id=\"root\" class=\"page other\" style=\"x\"><p class=\" keep drop \" align=\"left\">a</p>"
+            "<table width=\"1\" bgcolor=\"red\"><tr><td height=\"2\" class=\"drop\">b</td></tr></table>"
+            "<img width=\"3\"><svg style=\"y\"><rect width=\"4\"></rect></svg></div>"));
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+        DomSupport::Element *root = doc->getElementById("root");
+
+        root->cleanClasses({"page", "keep"});
+        root->cleanStyles({"align", "bgcolor", "style"}, {"TABLE", "TD"});
+        QCOMPARE(root->getAttribute("class"), QStringLiteral("page"));
+        QVERIFY(!root->hasAttribute("style"));
+        DomSupport::Element *p = root->firstElementChild();
+        QCOMPARE(p->getAttribute("class"), QStringLiteral("keep"));
+        QVERIFY(!p->hasAttribute("align"));
+        DomSupport::Element *table = p->nextElementSibling();
+        QVERIFY(table->attributes().isEmpty());
+        QVERIFY(table->getElementsByTagName("td").first()->attributes().isEmpty());
+        QCOMPARE(root->getElementsByTagName("img").first()->getAttribute("width"), QStringLiteral("3"));
+        // svg subtrees are left alone
+        QCOMPARE(root->getElementsByTagName("svg").first()->getAttribute("style"), QStringLiteral("y"));
+        QCOMPARE(root->getElementsByTagName("rect").first()->getAttribute("width"), QStringLiteral("4"));
+    }
+
+    void testResolveRelativeUris()
+    {
+        DomBuilder builder(QStringLiteral(
+            "<base href=\"base/\"><a href=\"foo.html#x\">a</a><a href=\"javascript:void(0)\">b</a>"
+            "<img src=\"/img.png\" srcset=\"small.png 1x, //cdn.example/large.png 2x\"><a href=\"#top\">c</a>"));
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl("http://fakehost/test/page.html")));
+        DomSupport::Element *body = doc->body();
+        QList<DomSupport::Element *> scriptLinks = doc->resolveRelativeUris(body);
+        QCOMPARE(scriptLinks.size(), 1);
+        QCOMPARE(scriptLinks.first()->getAttribute("href"), QStringLiteral("javascript:void(0)"));
+        QList<DomSupport::Element *> links = body->getElementsByTagName("a");
+        QCOMPARE(links.at(0)->getAttribute("href"), QStringLiteral("http://fakehost/test/base/foo.html#x"));
+        QCOMPARE(links.at(2)->getAttribute("href"), QStringLiteral("http://fakehost/test/base/#top"));
+        DomSupport::Element *img = body->getElementsByTagName("img").first();
+        QCOMPARE(img->getAttribute("src"), QStringLiteral("http://fakehost/img.png"));
+        QCOMPARE(img->getAttribute("srcset"),
+                 QStringLiteral("http://fakehost/test/base/small.png 1x, http://cdn.example/large.png 2x"));
+    }
+
+    void testSubtreeSearch()
+    {
+        DomBuilder builder(QStringLiteral(
+                "<div id='first'><p>one</p><div><p>two</p></div></div>"
+                "<div id='second'><p>three</p></div>"));
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+        DomSupport::Element *first = doc->getElementById("first");
+        QVERIFY(first);
+        QCOMPARE(first->getElementsByTagName("p").size(), 2);
+        QCOMPARE(first->getElementsByTagName("*").size(), 3);
+        DomSupport::Element *inner = first->getElementsByTagName("div").value(0);
+        QVERIFY(inner);
+        QCOMPARE(inner->getElementsByTagName("p").size(), 1);
+        QCOMPARE(inner->getElementsByTagName("p").first()->textContent(), QStringLiteral("two"));
+        QVERIFY(doc->getElementById("second"));
+        QCOMPARE(doc->getElementsByTagName("p").size(), 3);
+    }
+
+    void testBaseUri_data()
+    {
+        QTest::addColumn<QString>("href");
+        QTest::addColumn<QUrl>("expected");
+        QTest::newRow("absolute") << "http://other/dir/" << QUrl("http://other/dir/");
+        QTest::newRow("relative path") << "sub/dir/" << QUrl("http://fakehost/sub/dir/");
+        QTest::newRow("root relative") << "/root/" << QUrl("http://fakehost/root/");
+        QTest::newRow("scheme relative") << "//cdn/" << QUrl("http://cdn/");
+    }
+
+    void testBaseUri()
+    {
+        QFETCH(QString, href);
+        QFETCH(QUrl, expected);
+        DomBuilder builder(QStringLiteral("<base href='%1'><p>text</p>").arg(href));
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+        QCOMPARE(doc->baseURI(), expected);
+        QVERIFY(!doc->baseURI().isRelative());
+    }
+
+    void testMetadata()
+    {
+        DomBuilder builder(QStringLiteral(
+            "<meta property=\"og:title\" content=\" First \"><meta name=\"DC.Creator\" content=\"Someone\">"
+            "<meta name=\"description\" content=\"\"><noscript><meta name=\"title\" content=\"Hidden\"></noscript>"
+            "<script type=\"application/ld+json\">{\"@context\": \"https://schema.org\", \"@type\": \"WebSite\"}</script>"
+            "<script type=\"application/ld+json\"><![CDATA[{\"@context\": \"http://schema.org\", \"@graph\": "
+            "[{\"@type\": \"WebPage\"}, {\"@type\": \"NewsArticle\", \"headline\": \"Headline\"}]}]]></script>"
+            "<p>text</p>"));
+        builder.setSkipScripts(true);
+        std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+        QVERIFY(doc->metadataCaptured());
+        QVERIFY(doc->getElementsByTagName("script").isEmpty());
+        QCOMPARE(doc->metaValues().toMap(), (QVariantMap{{"og:title", "First"}, {"dc:creator", "Someone"}}));
+        QVariantMap article = doc->jsonLd().toMap();
+        QCOMPARE(article.value("@type").toString(), QStringLiteral("NewsArticle"));
+        QCOMPARE(article.value("headline").toString(), QStringLiteral("Headline"));
+    }
+
+    void testFragmentParser_data()
+    {
+        QTest::addColumn<QString>("html");
+        QTest::newRow("plain") << "plain text";
+        QTest::newRow("references") << "a &amp; b &lt;c&gt; &quot;d&quot; &#39;e&#x27; &nbsp;f";
+        QTest::newRow("astral") << "&#x1F600; &#128512;";
+        QTest::newRow("bare ampersands") << "fish & chips &&";
+        QTest::newRow("legacy references") << "&copy 2022 &eacute;";
+        QTest::newRow("invalid references") << "&#0; &#x80; &#xD800; &#99999999;";
+        QTest::newRow("markup") << "<p>one<br>two &amp; three</p>";
+        QTest::newRow("carriage return") << "one\r\ntwo";
+    }
+
+    void testFragmentParser()
+    {
+        QFETCH(QString, html);
+        DomSupport::Element expected("div");
+        DomBuilder builder(html, GUMBO_TAG_DIV);
+        builder.buildIntoNode(&expected);
+
+        DomSupport::Element actual("div");
+        actual.setInnerHTML(html);
+        QCOMPARE(actual.innerHTML(), expected.innerHTML());
+        QCOMPARE(actual.textContent(), expected.textContent());
+
+        DomSupport::Text text;
+        text.setInnerHTML(html);
+        QCOMPARE(text.textContent(), expected.textContent());
+    }
 };
 
 QTEST_MAIN(testDomSupport)
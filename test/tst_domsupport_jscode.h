@@ -188,6 +188,34 @@ constexpr const char *kTestNamespaces = R"!!!(
     verify(doc.documentElement===doc.firstChild);
 )!!!";
 
+constexpr const char *kTestClassifierFlags = R"!!!(
+    var foo = baseDoc.getElementById("foo");
+    verify(foo.classifierFlags === 0);
+
+    // flags must be recomputed whenever class or id change
+    foo.className = "comment";
+    verify((foo.classifierFlags & 0x01) !== 0); // unlikelyCandidates
+    verify((foo.classifierFlags & 0x20) !== 0); // negative class
+    foo.id = "main-content";
+    verify((foo.classifierFlags & 0x02) !== 0); // okMaybeItsACandidate
+    verify((foo.classifierFlags & 0x40) !== 0); // positive id
+    foo.removeAttribute("class");
+    verify((foo.classifierFlags & 0x21) === 0);
+    foo.setAttribute("id", "sharedaddy");
+    verify((foo.classifierFlags & 0x08) !== 0); // shareElements
+
+    // including when they are written through the attribute node
+    foo.setAttribute("class", "plain");
+    verify((foo.classifierFlags & 0x20) === 0);
+    for (var i = 0; i < foo.attributes.length; i++) {
+        if (foo.attributes[i].name === "class") {
+            foo.attributes[i].value = "comment";
+        }
+    }
+    verify(foo.className === "comment");
+    verify((foo.classifierFlags & 0x20) !== 0);
+)!!!";
+
 }
 
 #endif // TST_DOMSUPPORT_JSCODE_H
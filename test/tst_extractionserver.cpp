@@ -0,0 +1,187 @@
+#include <QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QtEndian>
+
+#include "extractionserver.h"
+
+using namespace QReadable;
+
+static QByteArray toFrame(const QByteArray &payload)
+{
+    QByteArray frame(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), frame.data());
+    return frame + payload;
+}
+
+static QByteArray syntheticArticle(int n)
+{
+    QByteArray paragraph("This paragraph has enough words in it, and enough commas too, that Readability "
+                         "will consider it part of the article rather than boilerplate around it. ");
+    return "<html><head><title>Article " + QByteArray::number(n) + "</title></head><body><div>"
+            "<p>" + paragraph + "</p><p>" + paragraph + "</p><p>" + paragraph + "</p></div></body></html>";
+}
+
+/**
+ * A client that collects the server's response frames as they arrive
+ */
+class TestClient : public QObject
+{
+public:
+    explicit TestClient(const QString &path)
+    {
+        connect(&m_socket, &QLocalSocket::readyRead, this, [this]{
+            m_buffer += m_socket.readAll();
+            while (m_buffer.size() >= 4) {
+                quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(m_buffer.constData()));
+                if (m_buffer.size() < 4 + int(length)) {
+                    break;
+                }
+                m_responses << QJsonDocument::fromJson(m_buffer.mid(4, int(length))).object();
+                m_buffer.remove(0, 4 + int(length));
+            }
+        });
+        connect(&m_socket, &QLocalSocket::disconnected, this, [this]{ m_disconnected = true; });
+        m_socket.connectToServer(path);
+    }
+
+    void send(const QJsonObject &header, const QByteArray &html)
+    {
+        m_socket.write(toFrame(QJsonDocument(header).toJson(QJsonDocument::Compact)) + toFrame(html));
+        m_socket.flush();
+    }
+
+    QLocalSocket m_socket;
+    QByteArray m_buffer;
+    QList<QJsonObject> m_responses;
+    bool m_disconnected{false};
+};
+
+class testExtractionServer : public QObject
+{
+    Q_OBJECT
+    QTemporaryDir m_dir;
+
+    QString socketPath() const
+    {
+        return m_dir.filePath("server.sock");
+    }
+
+private slots:
+    void testFraming()
+    {
+        ExtractionServer server(2, ReadableOptions());
+        QVERIFY(server.listenLocal(socketPath()));
+        TestClient client(socketPath());
+        QVERIFY(client.m_socket.waitForConnected(5000));
+
+        // a request split at awkward places, including inside a length prefix
+        QByteArray request = toFrame(R"({"id": "first", "url": "http://fakehost/", "format": "text"})") +
+                toFrame(syntheticArticle(1));
+        const int cuts[] = {0, 2, 9, 70, request.size()};
+        for (int i = 0; i + 1 < 5; i++) {
+            client.m_socket.write(request.mid(cuts[i], cuts[i + 1] - cuts[i]));
+            client.m_socket.flush();
+            QTest::qWait(20);
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(client.m_responses.size(), 1, 30000);
+        QJsonObject response = client.m_responses.first();
+        QCOMPARE(response.value("id").toString(), QStringLiteral("first"));
+        QCOMPARE(response.value("title").toString(), QStringLiteral("Article 1"));
+        QVERIFY(!response.value("content").toString().contains('<'));
+
+        client.send({{"id", "second"}, {"url", "http://fakehost/"}, {"format", "bogus"}}, syntheticArticle(2));
+        QTRY_COMPARE_WITH_TIMEOUT(client.m_responses.size(), 2, 30000);
+        QCOMPARE(client.m_responses.at(1).value("id").toString(), QStringLiteral("second"));
+        QVERIFY(client.m_responses.at(1).value("error").toString().contains("bogus"));
+        QVERIFY(!client.m_disconnected);
+    }
+
+    void testPipelinedOrder()
+    {
+        ExtractionServer server(4, ReadableOptions());
+        QVERIFY(server.listenLocal(socketPath()));
+        TestClient client(socketPath());
+        QVERIFY(client.m_socket.waitForConnected(5000));
+
+        // more requests than a connection may have in flight, with slow and quick ones interleaved
+        static constexpr int kRequests = 48;
+        QByteArray slow = syntheticArticle(0).repeated(20);
+        for (int i = 0; i < kRequests; i++) {
+            client.send({{"id", i}, {"url", "http://fakehost/"}}, i % 3 == 0 ? slow : syntheticArticle(i));
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(client.m_responses.size(), kRequests, 120000);
+        for (int i = 0; i < kRequests; i++) {
+            QCOMPARE(client.m_responses.at(i).value("id").toInt(), i);
+            QVERIFY(client.m_responses.at(i).value("found").toBool());
+        }
+    }
+
+    void testProtocolErrors_data()
+    {
+        QTest::addColumn<QByteArray>("garbage");
+        QTest::addColumn<QString>("error");
+        QTest::newRow("bad header") << toFrame("not json") + toFrame("<p>x</p>") + toFrame("more")
+                                    << "request header is not a JSON object";
+        QTest::newRow("too large") << QByteArray("\xff\xff\xff\xff garbage")
+                                   << "frame too large";
+    }
+
+    void testProtocolErrors()
+    {
+        QFETCH(QByteArray, garbage);
+        QFETCH(QString, error);
+        ExtractionServer server(2, ReadableOptions());
+        QVERIFY(server.listenLocal(socketPath()));
+        TestClient client(socketPath());
+        QVERIFY(client.m_socket.waitForConnected(5000));
+
+        // the request before the error is still answered, and first
+        client.send({{"id", "ok"}, {"url", "http://fakehost/"}}, syntheticArticle(1));
+        client.m_socket.write(garbage);
+        client.m_socket.flush();
+        QTRY_VERIFY_WITH_TIMEOUT(client.m_disconnected, 30000);
+        QCOMPARE(client.m_responses.size(), 2);
+        QCOMPARE(client.m_responses.at(0).value("id").toString(), QStringLiteral("ok"));
+        QCOMPARE(client.m_responses.at(1).value("error").toString(), error);
+
+        // other connections are unaffected
+        TestClient other(socketPath());
+        QVERIFY(other.m_socket.waitForConnected(5000));
+        other.send({{"id", "other"}, {"url", "http://fakehost/"}}, syntheticArticle(2));
+        QTRY_COMPARE_WITH_TIMEOUT(other.m_responses.size(), 1, 30000);
+        QCOMPARE(other.m_responses.first().value("title").toString(), QStringLiteral("Article 2"));
+    }
+
+    void testDrain()
+    {
+        ExtractionServer server(2, ReadableOptions());
+        QVERIFY(server.listenLocal(socketPath()));
+        QSignalSpy drained(&server, &ExtractionServer::drained);
+        TestClient idle(socketPath());
+        QVERIFY(idle.m_socket.waitForConnected(5000));
+        TestClient client(socketPath());
+        QVERIFY(client.m_socket.waitForConnected(5000));
+
+        static constexpr int kRequests = 6;
+        for (int i = 0; i < kRequests; i++) {
+            client.send({{"id", i}, {"url", "http://fakehost/"}}, syntheticArticle(i));
+        }
+        QTRY_VERIFY_WITH_TIMEOUT(!client.m_responses.isEmpty(), 30000);
+        server.drain();
+        QTRY_COMPARE_WITH_TIMEOUT(drained.count(), 1, 30000);
+        QTRY_VERIFY(idle.m_disconnected);
+        QTRY_VERIFY(client.m_disconnected);
+        QCOMPARE(client.m_responses.size(), kRequests);
+        for (int i = 0; i < kRequests; i++) {
+            QCOMPARE(client.m_responses.at(i).value("id").toInt(), i);
+        }
+
+        TestClient late(socketPath());
+        QVERIFY(!late.m_socket.waitForConnected(1000));
+    }
+};
+
+QTEST_MAIN(testExtractionServer)
+#include "tst_extractionserver.moc"
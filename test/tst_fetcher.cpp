@@ -0,0 +1,180 @@
+#include <QtTest>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <mutex>
+
+#include "fetcher.h"
+
+using namespace QReadable;
+
+/**
+ * A stand-in HTTP server that serves the test-pages corpus
+ *
+ * GET /<page>/ returns the page's source.html, deflate-encoded if the
+ * client accepts it, with an ETag, and answers matching conditional
+ * requests with 304 Not Modified.
+ */
+class TestPageServer : public QObject
+{
+public:
+    TestPageServer()
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, [this]{
+            while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+                m_openConnections++;
+                m_peakConnections = qMax(m_peakConnections, m_openConnections);
+                connect(socket, &QTcpSocket::readyRead, this, [this, socket]{ serve(socket); });
+                connect(socket, &QTcpSocket::disconnected, this, [this, socket]{
+                    m_openConnections--;
+                    socket->deleteLater();
+                });
+            }
+        });
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url(const QString &page) const
+    {
+        return QUrl(QStringLiteral("http://127.0.0.1:%1/%2/").arg(m_server.serverPort()).arg(page));
+    }
+
+    int m_openConnections{0};
+    int m_peakConnections{0};
+    int m_notModified{0};
+
+private:
+    void serve(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            QByteArray request = buffer.left(end);
+            buffer.remove(0, end + 4);
+            respond(socket, request);
+        }
+    }
+
+    void respond(QTcpSocket *socket, const QByteArray &request)
+    {
+        QList<QByteArray> lines = request.split('\n');
+        QByteArray path = lines.first().split(' ').value(1);
+        QByteArray ifNoneMatch;
+        bool acceptsDeflate = false;
+        for (const QByteArray &line : lines) {
+            QByteArray lower = line.trimmed().toLower();
+            if (lower.startsWith("if-none-match:")) {
+                ifNoneMatch = line.mid(line.indexOf(':') + 1).trimmed();
+            } else if (lower.startsWith("accept-encoding:") && lower.contains("deflate")) {
+                acceptsDeflate = true;
+            }
+        }
+
+        QFile file(QStringLiteral(QREADABLE_TEST_PAGES_DIR "%1source.html").arg(QString::fromUtf8(path)));
+        if (!file.open(QFile::ReadOnly)) {
+            socket->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+            return;
+        }
+        QByteArray etag = '"' + QByteArray::number(qHash(path)) + '"';
+        if (ifNoneMatch == etag) {
+            m_notModified++;
+            socket->write("HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\nCache-Control: max-age=0\r\n\r\n");
+            return;
+        }
+        QByteArray body = file.readAll();
+        QByteArray headers = "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\n"
+                             "Cache-Control: max-age=0\r\nETag: " + etag + "\r\n";
+        if (acceptsDeflate) {
+            // qCompress output is a zlib stream behind a 4-byte length
+            body = qCompress(body).mid(4);
+            headers += "Content-Encoding: deflate\r\n";
+        }
+        headers += "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n";
+        socket->write(headers + body);
+    }
+
+    QTcpServer m_server;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+};
+
+static QJsonObject readExpectedMetadata(const QString &name)
+{
+    QFile file(QStringLiteral(QREADABLE_TEST_PAGES_DIR "/%1/expected-metadata.json").arg(name));
+    if (!file.open(QFile::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+class testFetcher : public QObject
+{
+    Q_OBJECT
+
+private:
+    // fetch pages from server, returning result records by request URL
+    QHash<QString, QJsonObject> fetch(TestPageServer &server, const QStringList &pages, const FetchOptions &options)
+    {
+        std::mutex mutex;
+        QHash<QString, QJsonObject> records;
+        auto handler = [&](const QJsonObject &record) {
+            std::lock_guard<std::mutex> lock(mutex);
+            records.insert(record.value("requestUrl").toString(), record);
+        };
+        WorkerPool pool(2, ReadableOptions(), handler);
+        Fetcher fetcher(&pool, options, handler);
+        QSignalSpy finished(&fetcher, &Fetcher::finished);
+        for (const QString &page : pages) {
+            fetcher.add(server.url(page));
+        }
+        fetcher.finishAdding();
+        if (finished.isEmpty()) {
+            finished.wait(60000);
+        }
+        pool.finish();
+        return records;
+    }
+
+private slots:
+    void testFetchAndExtract()
+    {
+        TestPageServer server;
+        FetchOptions options;
+        options.maxPerHost = 2;
+        QStringList pages{"001", "002", "003", "004", "does-not-exist"};
+        QHash<QString, QJsonObject> records = fetch(server, pages, options);
+        QCOMPARE(records.size(), pages.size());
+        for (int i = 0; i < 4; i++) {
+            QJsonObject record = records.value(server.url(pages.at(i)).toString());
+            QCOMPARE(record.value("httpStatus").toInt(), 200);
+            QCOMPARE(record.value("title").toString(), readExpectedMetadata(pages.at(i)).value("title").toString());
+        }
+        QJsonObject missing = records.value(server.url("does-not-exist").toString());
+        QVERIFY(missing.contains("error"));
+        QVERIFY(server.m_peakConnections <= options.maxPerHost);
+    }
+
+    void testConditionalRequests()
+    {
+        QTemporaryDir cacheDir;
+        QVERIFY(cacheDir.isValid());
+        TestPageServer server;
+        FetchOptions options;
+        options.cacheDirectory = cacheDir.path();
+
+        QHash<QString, QJsonObject> first = fetch(server, {"001"}, options);
+        QCOMPARE(server.m_notModified, 0);
+        QHash<QString, QJsonObject> second = fetch(server, {"001"}, options);
+        QCOMPARE(server.m_notModified, 1);
+
+        QString url = server.url("001").toString();
+        QVERIFY(second.value(url).value("fromCache").toBool());
+        QCOMPARE(second.value(url).value("title").toString(), first.value(url).value("title").toString());
+        QCOMPARE(second.value(url).value("content").toString(), first.value(url).value("content").toString());
+    }
+};
+
+QTEST_MAIN(testFetcher)
+#include "tst_fetcher.moc"
@@ -0,0 +1,531 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <memory>
+
+#include "dombuilder.h"
+#include "readable.h"
+#include "resultcache.h"
+#include "textserializer.h"
+
+using namespace QReadable;
+
+static constexpr const char *kTestUrl = "http://fakehost/test/page.html";
+
+static QByteArray readTestPageData(const QString &name)
+{
+    QFile file(QStringLiteral(QREADABLE_TEST_PAGES_DIR "/%1/source.html").arg(name));
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+static QString syntheticArticle()
+{
+    QString paragraph = QStringLiteral("This paragraph has enough words in it, and enough commas too, that Readability "
+                                       "will consider it part of the article rather than boilerplate around it. ");
+    return QStringLiteral("<html><body><div id=\"main\"><h2>Heading</h2>"
+                          "<p>%1 It has <strong>bold text</strong> and <a href=\"/x\">a link</a>.</p>"
+                          "<p>%1</p><ul><li>%1</li><li>%1</li></ul><p>%1</p></div></body></html>").arg(paragraph);
+}
+
+static QJsonObject readExpectedMetadata(const QString &name)
+{
+    QFile file(QStringLiteral(QREADABLE_TEST_PAGES_DIR "/%1/expected-metadata.json").arg(name));
+    if (!file.open(QFile::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+static QString readExpectedContent(const QString &name)
+{
+    QFile file(QStringLiteral(QREADABLE_TEST_PAGES_DIR "/%1/expected.html").arg(name));
+    if (!file.open(QFile::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+// The nodes of \a html in document order, described as test-readability.js compares them:
+// whitespace-only text is left out, other text has its whitespace collapsed, and
+// elements are described by their tag and attributes
+static QStringList describeNodes(const QString &html)
+{
+    DomBuilder builder(html);
+    std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+    QStringList nodes;
+    QList<DomSupport::Node *> stack;
+    for (DomSupport::Node *child = doc->body()->lastChild(); child; child = child->previousSibling()) {
+        stack.append(child);
+    }
+    while (!stack.isEmpty()) {
+        DomSupport::Node *node = stack.takeLast();
+        if (node->nodeType() == DomSupport::Node::TEXT_NODE) {
+            QString text = static_cast<DomSupport::Text *>(node)->textContent().simplified();
+            if (!text.isEmpty()) {
+                nodes.append(QStringLiteral("#text(%1)").arg(text));
+            }
+            continue;
+        }
+        if (node->nodeType() != DomSupport::Node::ELEMENT_NODE) {
+            continue;
+        }
+        QStringList attributes;
+        for (DomSupport::Attribute *attribute : node->attributes()) {
+            attributes.append(attribute->name() + '=' + attribute->value());
+        }
+        attributes.sort();
+        nodes.append(QStringLiteral("%1 [%2]").arg(node->localName(), attributes.join(',')));
+        for (DomSupport::Node *child = node->lastChild(); child; child = child->previousSibling()) {
+            stack.append(child);
+        }
+    }
+    return nodes;
+}
+
+static int s_jsErrorWarnings = 0;
+
+static void countJsErrors(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type == QtWarningMsg && message.startsWith(QLatin1String("unhandled js error"))) {
+        s_jsErrorWarnings++;
+    }
+}
+
+static QString toMarkdown(const QString &html)
+{
+    DomBuilder builder(html);
+    std::unique_ptr<DomSupport::Document> doc(builder.buildDocument(QUrl(kTestUrl)));
+    return TextSerializer::toMarkdown(doc->body());
+}
+
+class testReadable : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testArticleFields()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        QVERIFY(!source.isEmpty());
+        QJsonObject expected = readExpectedMetadata("001");
+
+        Readable readable;
+        Article article = readable.parse(source, QUrl(kTestUrl));
+        QVERIFY(!article.isNull());
+        QCOMPARE(article.title(), expected.value("title").toString());
+        QCOMPARE(article.excerpt(), expected.value("excerpt").toString());
+        QVERIFY(!article.content().isEmpty());
+        QCOMPARE(article.length(), article.textContent().length());
+    }
+
+    void testTestPages_data()
+    {
+        QTest::addColumn<QString>("page");
+        const QStringList pages = QDir(QStringLiteral(QREADABLE_TEST_PAGES_DIR)).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &page : pages) {
+            QTest::newRow(qPrintable(page)) << page;
+        }
+    }
+
+    // every page Readability.js is tested against upstream, compared the way its test-readability.js does
+    void testTestPages()
+    {
+        QFETCH(QString, page);
+        QByteArray source = readTestPageData(page);
+        QVERIFY(!source.isEmpty());
+        QJsonObject expected = readExpectedMetadata(page);
+
+        ReadableOptions options;
+        options.classesToPreserve = QStringList{QStringLiteral("caption")};
+        Readable readable(options);
+        Article article = readable.parse(source, QUrl(kTestUrl));
+        QVERIFY(!article.isNull());
+
+        QStringList actualNodes = describeNodes(article.content());
+        QStringList expectedNodes = describeNodes(readExpectedContent(page));
+        for (int i = 0; i < qMin(actualNodes.size(), expectedNodes.size()); i++) {
+            QCOMPARE(actualNodes.at(i), expectedNodes.at(i));
+        }
+        QCOMPARE(actualNodes.size(), expectedNodes.size());
+
+        QCOMPARE(article.title(), expected.value("title").toString());
+        QCOMPARE(article.byline(), expected.value("byline").toString());
+        QCOMPARE(article.excerpt(), expected.value("excerpt").toString());
+        QCOMPARE(article.siteName(), expected.value("siteName").toString());
+        if (expected.value("dir").isString()) {
+            QCOMPARE(article.dir(), expected.value("dir").toString());
+        }
+        if (expected.value("lang").isString()) {
+            QCOMPARE(article.lang(), expected.value("lang").toString());
+        }
+        if (expected.contains("readerable")) {
+            QCOMPARE(Readable::isProbablyReaderable(source), expected.value("readerable").toBool());
+        }
+    }
+
+    void testNullArticle()
+    {
+        Readable readable;
+        Article article = readable.parse("<html><body></body></html>", QUrl(kTestUrl));
+        QVERIFY(article.isNull());
+        QVERIFY(article.content().isNull());
+        QCOMPARE(article.length(), 0);
+    }
+
+    void testOptions()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        Readable readable;
+        QString stripped = readable.parse(source, QUrl(kTestUrl)).content();
+
+        ReadableOptions keepClasses;
+        keepClasses.keepClasses = true;
+        QString kept = readable.parse(source, QUrl(kTestUrl), keepClasses).content();
+        QVERIFY(kept.count("class=") > stripped.count("class="));
+
+        // the per-call options must not leak into later calls
+        QCOMPARE(readable.parse(source, QUrl(kTestUrl)).content(), stripped);
+
+        Readable keepingReadable(keepClasses);
+        QCOMPARE(keepingReadable.parse(source, QUrl(kTestUrl)).content(), kept);
+    }
+
+    void testPlainTextOutput()
+    {
+        ReadableOptions options;
+        options.outputFormat = OutputFormat::PlainText;
+        Readable readable(options);
+        QString text = readable.parse(syntheticArticle(), QUrl(kTestUrl)).content();
+        QVERIFY(!text.isEmpty());
+        QVERIFY(!text.contains('<'));
+        QVERIFY(text.contains("It has bold text and a link."));
+        QVERIFY(text.contains("\n\n"));
+        QVERIFY(!text.contains("  "));
+    }
+
+    void testMarkdownOutput()
+    {
+        ReadableOptions options;
+        options.outputFormat = OutputFormat::Markdown;
+        Readable readable(options);
+        QString markdown = readable.parse(syntheticArticle(), QUrl(kTestUrl)).content();
+        QVERIFY(markdown.contains("## Heading"));
+        QVERIFY(markdown.contains("It has **bold text** and [a link](http://fakehost/x)."));
+        QVERIFY(markdown.contains("\n- This paragraph"));
+
+        // a table in a cell becomes that cell's text
+        QCOMPARE(toMarkdown("<table><tr><th>A</th><th>B</th></tr>"
+                            "<tr><td><table><tr><td>x</td><td>y</td></tr><tr><td>z</td></tr></table></td><td>w</td></tr></table>"),
+                 QStringLiteral("| A | B |\n| --- | --- |\n| x y z | w |"));
+        QCOMPARE(toMarkdown("<table><tr><td>a|b</td><td><code>c|d</code></td></tr></table>"),
+                 QStringLiteral("| a\\|b | `c\\|d` |\n| --- | --- |"));
+
+        // text that would start a block is escaped at the start of a line only
+        QCOMPARE(toMarkdown("<p># tag</p><p>&gt; quote</p><p>- item</p><p>1999. A year</p><p>Not # a heading - 1999.</p>"),
+                 QStringLiteral("\\# tag\n\n\\> quote\n\n\\- item\n\n1999\\. A year\n\nNot # a heading - 1999."));
+        QCOMPARE(toMarkdown("<ul><li># tag</li></ul>"), QStringLiteral("- \\# tag"));
+
+        // the space inside emphasis goes before its markup
+        QCOMPARE(toMarkdown("<p>Some<b> bold</b> and<i> italic </i>text</p>"),
+                 QStringLiteral("Some **bold** and *italic* text"));
+    }
+
+    void testNodeBudget()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        ParseLimits limits;
+        limits.maxNodes = 50;
+        Readable readable;
+        Article article = readable.parse(source, QUrl(kTestUrl), limits);
+        QCOMPARE(article.status(), Article::Truncated);
+    }
+
+    void testExactNodeBudget()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        Readable readable;
+        readable.setCollectStats(true);
+        Article full = readable.parse(source, QUrl(kTestUrl));
+        int nodeCount = readable.lastParseStats().nodesBuilt;
+        QVERIFY(nodeCount > 0);
+
+        ParseLimits limits;
+        limits.maxNodes = nodeCount;
+        Article exact = readable.parse(source, QUrl(kTestUrl), limits);
+        QCOMPARE(exact.status(), Article::Complete);
+        QCOMPARE(exact.content(), full.content());
+
+        limits.maxNodes = nodeCount - 1;
+        QCOMPARE(readable.parse(source, QUrl(kTestUrl), limits).status(), Article::Truncated);
+        QCOMPARE(readable.lastParseStats().nodesBuilt, nodeCount - 1);
+    }
+
+    void testByteBudget()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        ParseLimits limits;
+        limits.maxBytes = 1024;
+        Readable readable;
+        Article article = readable.parse(source, QUrl(kTestUrl), limits);
+        QCOMPARE(article.status(), Article::Truncated);
+    }
+
+    void testParseFile()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        Readable readable;
+        Article expected = readable.parse(source, QUrl(kTestUrl));
+        Article fromUtf8 = readable.parse(readTestPageData("001"), QUrl(kTestUrl), ReadableOptions(), ParseLimits());
+        QCOMPARE(fromUtf8.content(), expected.content());
+        Article article = readable.parseFile(QStringLiteral(QREADABLE_TEST_PAGES_DIR "/001/source.html"), QUrl(kTestUrl));
+        QCOMPARE(article.status(), Article::Complete);
+        QCOMPARE(article.title(), expected.title());
+        QCOMPARE(article.content(), expected.content());
+
+        Article missing = readable.parseFile(QStringLiteral(QREADABLE_TEST_PAGES_DIR "/does-not-exist.html"));
+        QVERIFY(missing.isNull());
+        QCOMPARE(missing.status(), Article::ReadError);
+    }
+
+    void testResultCache()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString storePath = dir.filePath("results.cache");
+        QString source = QString::fromUtf8(readTestPageData("001"));
+
+        auto cache = std::make_shared<ResultCache>();
+        QVERIFY(cache->setDiskStore(storePath));
+        Readable readable;
+        readable.setResultCache(cache);
+        Article parsed = readable.parse(source, QUrl(kTestUrl));
+        Article cached = readable.parse(source, QUrl(kTestUrl));
+        QCOMPARE(cache->stats().misses, quint64(1));
+        QCOMPARE(cache->stats().memoryHits, quint64(1));
+        QCOMPARE(cached.title(), parsed.title());
+        QCOMPARE(cached.content(), parsed.content());
+        QCOMPARE(cached.length(), parsed.length());
+
+        // different options are a different result
+        ReadableOptions options;
+        options.keepClasses = true;
+        readable.parse(source, QUrl(kTestUrl), options);
+        QCOMPARE(cache->stats().misses, quint64(2));
+
+        auto reopened = std::make_shared<ResultCache>();
+        QVERIFY(reopened->setDiskStore(storePath));
+        readable.setResultCache(reopened);
+        Article fromDisk = readable.parse(source, QUrl(kTestUrl));
+        QCOMPARE(reopened->stats().diskHits, quint64(1));
+        QCOMPARE(fromDisk.content(), parsed.content());
+        QCOMPARE(fromDisk.byline(), parsed.byline());
+
+        // a store written by another version is discarded rather than trusted
+        reopened.reset();
+        QFile stale(storePath);
+        QVERIFY(stale.open(QFile::ReadWrite));
+        stale.write("QRCACHE1");
+        stale.close();
+        auto fresh = std::make_shared<ResultCache>();
+        QVERIFY(fresh->setDiskStore(storePath));
+        readable.setResultCache(fresh);
+        readable.parse(source, QUrl(kTestUrl));
+        QCOMPARE(fresh->stats().diskHits, quint64(0));
+        QCOMPARE(fresh->stats().misses, quint64(1));
+    }
+
+    void testParseStats()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        Readable readable;
+        Article expected = readable.parse(source, QUrl(kTestUrl));
+        QVERIFY(readable.lastParseStats().phases.isEmpty());
+
+        readable.setCollectStats(true);
+        Article article = readable.parse(source, QUrl(kTestUrl));
+        QCOMPARE(article.content(), expected.content());
+
+        ParseStats stats = readable.lastParseStats();
+        QStringList phases;
+        for (const ParseStats::Phase &eachPhase : qAsConst(stats.phases)) {
+            phases << eachPhase.name;
+        }
+        QCOMPARE(phases, QStringList({"gumboParse", "domBuild", "extraction", "serialization"}));
+        QVERIFY(stats.phaseNs("extraction") > 0);
+        QVERIFY(stats.totalNs >= stats.phases.last().startNs + stats.phases.last().durationNs);
+        QCOMPARE(stats.inputBytes, qint64(source.toUtf8().size()));
+        QVERIFY(stats.nodesBuilt > 0);
+        QVERIFY(stats.elementsRemoved > 0);
+        QVERIFY(stats.grabArticleAttempts >= 1);
+        QVERIFY(stats.nativeCalls.value("Element.tagName").count > 0);
+        QCOMPARE(stats.nativeCalls.value("Element.tagName").totalNs, qint64(0));
+        QCOMPARE(stats.outputSize, qint64(article.content().size()));
+
+        QJsonObject trace = QJsonDocument::fromJson(stats.toChromeTrace()).object();
+        QCOMPARE(trace.value("traceEvents").toArray().size(), stats.phases.size() + 1);
+    }
+
+    void testElementsRemovedByReplacement()
+    {
+        // each single-<p> <div> is unwrapped, and the javascript: link replaced by its text, with replaceChild
+        QString paragraph = QStringLiteral("This paragraph has enough words in it, and enough commas too, that Readability "
+                                           "will consider it part of the article rather than boilerplate around it. ");
+        QString html = QStringLiteral("<html><body><div><div><p>%1<a href=\"javascript:void(0)\">More</a></p></div>").arg(paragraph);
+        for (int i = 0; i < 4; i++) {
+            html += QStringLiteral("<div><p>%1</p></div>").arg(paragraph);
+        }
+        html += QStringLiteral("</div></body></html>");
+
+        Readable readable;
+        readable.setCollectStats(true);
+        Article article = readable.parse(html, QUrl(kTestUrl));
+        QVERIFY(!article.content().contains("javascript:"));
+        QVERIFY(readable.lastParseStats().elementsRemoved >= 6);
+    }
+
+    void testProfileNativeCalls()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        Readable readable;
+        readable.setProfileNativeCalls(true);
+        QVERIFY(readable.collectsStats());
+        readable.parse(source, QUrl(kTestUrl));
+
+        NativeCallTable calls = readable.lastParseStats().nativeCalls;
+        NativeCallStats childNodes = calls.value("Node.childNodes");
+        QVERIFY(childNodes.count > 0);
+        QVERIFY(childNodes.totalNs > 0);
+        QVERIFY(childNodes.bytes > 0);
+        QVERIFY(calls.value("Element.getAttribute").bytes > 0);
+
+        QStringList lines = nativeCallReport(calls).trimmed().split('\n');
+        QCOMPARE(lines.size(), calls.size() + 1);
+        QVERIFY(lines.first().startsWith("member"));
+
+        readable.setCollectStats(false);
+        QVERIFY(!readable.profilesNativeCalls());
+    }
+
+    // a container of many <br><br> chains is rewritten in time linear in its size
+    void testManyBrChains()
+    {
+        auto mutationNs = [](int chains) {
+            QString html = QStringLiteral("<html><body><div>");
+            for (int i = 0; i < chains; i++) {
+                html += QStringLiteral("Line %1 of a poem, with a few words in it<br><br>\n").arg(i);
+            }
+            html += QStringLiteral("</div></body></html>");
+            Readable readable;
+            readable.setProfileNativeCalls(true);
+            Article article = readable.parse(html, QUrl(kTestUrl));
+            if (article.content().count(QLatin1String("<p>")) != chains) {
+                return qint64(-1);
+            }
+            const NativeCallTable calls = readable.lastParseStats().nativeCalls;
+            qint64 nsecs = 0;
+            for (const char *member : {"Node.appendChild", "Node.removeChild", "Node.replaceChild", "Node.moveChildrenTo"}) {
+                nsecs += calls.value(member).totalNs;
+            }
+            return nsecs;
+        };
+        qint64 small = mutationNs(2000);
+        qint64 large = mutationNs(8000);
+        QVERIFY(small > 0);
+        QVERIFY(large > 0);
+        // four times the chains: about four times the time, where a quadratic rewrite takes sixteen
+        QVERIFY2(large < 8 * small, qPrintable(QStringLiteral("%1 ns, then %2 ns").arg(small).arg(large)));
+    }
+
+    void testCancellation()
+    {
+        QString source = QString::fromUtf8(readTestPageData("001"));
+        CancellationToken token;
+        token.cancel();
+        Readable readable;
+        Article article = readable.parse(source, QUrl(kTestUrl), ParseLimits(), token);
+        QCOMPARE(article.status(), Article::Cancelled);
+        QVERIFY(article.isNull());
+
+        // the engine must still be usable afterwards
+        Article next = readable.parse(source, QUrl(kTestUrl), ParseLimits(), CancellationToken());
+        QCOMPARE(next.status(), Article::Complete);
+        QVERIFY(!next.isNull());
+    }
+
+    void testTimeoutDuringExtraction()
+    {
+        QString source;
+        for (int i = 0; i < 200; i++) {
+            source += syntheticArticle();
+        }
+        Readable readable;
+        readable.setCollectStats(true);
+        QVERIFY(!readable.parse(source, QUrl(kTestUrl)).isNull());
+        ParseStats untimed = readable.lastParseStats();
+        qint64 extractionStartNs = 0;
+        for (const ParseStats::Phase &eachPhase : qAsConst(untimed.phases)) {
+            if (eachPhase.name == "extraction") {
+                extractionStartNs = eachPhase.startNs;
+            }
+        }
+        qint64 extractionNs = untimed.phaseNs("extraction");
+        if (extractionNs < 20000000) {
+            QSKIP("extraction is too quick to interrupt reliably");
+        }
+
+        // time out halfway through the script phase
+        ParseLimits limits;
+        limits.timeout = std::chrono::milliseconds((extractionStartNs + extractionNs / 2) / 1000000);
+        s_jsErrorWarnings = 0;
+        QtMessageHandler previousHandler = qInstallMessageHandler(countJsErrors);
+        Article article = readable.parse(source, QUrl(kTestUrl), limits);
+        qInstallMessageHandler(previousHandler);
+        QCOMPARE(article.status(), Article::TimedOut);
+        // the interrupt is reported by the status, not logged as a script error
+        QCOMPARE(s_jsErrorWarnings, 0);
+        QVERIFY(article.isNull());
+        // the DOM was built, so it was the script that was interrupted
+        QVERIFY(readable.lastParseStats().phaseNs("extraction") > 0);
+
+        // the same watchdog is re-armed, and the engine is usable again
+        limits.timeout = std::chrono::minutes(10);
+        Article next = readable.parse(syntheticArticle(), QUrl(kTestUrl), limits);
+        QCOMPARE(next.status(), Article::Complete);
+        QVERIFY(!next.isNull());
+    }
+
+    void testIsProbablyReaderable_data()
+    {
+        QTest::addColumn<QString>("page");
+        QTest::newRow("001") << "001";
+        QTest::newRow("mozilla-2") << "mozilla-2";
+        QTest::newRow("remove-aria-hidden") << "remove-aria-hidden";
+        QTest::newRow("js-link-replacement") << "js-link-replacement";
+    }
+
+    void testIsProbablyReaderable()
+    {
+        QFETCH(QString, page);
+        QByteArray source = readTestPageData(page);
+        QVERIFY(!source.isEmpty());
+        bool expected = readExpectedMetadata(page).value("readerable").toBool();
+        QCOMPARE(Readable::isProbablyReaderable(source), expected);
+    }
+
+    void testReaderableThresholds()
+    {
+        QByteArray source = readTestPageData("001");
+        ReaderableOptions strict;
+        strict.minContentLength = 1000000;
+        QVERIFY(!Readable::isProbablyReaderable(source, strict));
+    }
+};
+
+QTEST_MAIN(testReadable)
+#include "tst_readable.moc"
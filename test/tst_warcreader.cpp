@@ -0,0 +1,169 @@
+#include <QtTest>
+#include <QBuffer>
+#include <zlib.h>
+
+#include "warcreader.h"
+
+using namespace QReadable;
+
+static QByteArray warcRecord(const QByteArray &type, const QByteArray &uri, const QByteArray &block)
+{
+    return "WARC/1.0\r\nWARC-Type: " + type + "\r\nWARC-Target-URI: " + uri +
+            "\r\nContent-Length: " + QByteArray::number(block.size()) + "\r\n\r\n" + block + "\r\n\r\n";
+}
+
+// One gzip member, as each record of a .warc.gz file is compressed
+static QByteArray gzip(const QByteArray &data)
+{
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    QByteArray out(static_cast<int>(deflateBound(&stream, static_cast<uLong>(data.size()))), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.truncate(static_cast<int>(stream.total_out));
+    deflateEnd(&stream);
+    return out;
+}
+
+static QByteArray httpResponse(const QByteArray &headers, const QByteArray &body)
+{
+    return "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n" + headers + "\r\n" + body;
+}
+
+static QList<WarcRecord> readAll(const QByteArray &data, QString &error)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    WarcReader reader(&buffer);
+    QList<WarcRecord> records;
+    WarcRecord record;
+    while (reader.readRecord(record)) {
+        records << record;
+    }
+    error = reader.errorString();
+    return records;
+}
+
+class testWarcReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRecords_data()
+    {
+        QTest::addColumn<bool>("compressed");
+        QTest::newRow("plain") << false;
+        QTest::newRow("gzip members") << true;
+    }
+
+    void testRecords()
+    {
+        QFETCH(bool, compressed);
+        // big enough that a record spans several reads from the device
+        QByteArray large = httpResponse("", QByteArray(600 * 1024, 'x'));
+        QList<QByteArray> records{
+            warcRecord("warcinfo", "", "software: test\r\n"),
+            warcRecord("response", "http://example.com/", httpResponse("", "<p>one</p>")),
+            warcRecord("response", "http://example.com/large", large),
+        };
+        QByteArray data;
+        for (const QByteArray &record : records) {
+            data += compressed ? gzip(record) : record;
+        }
+
+        QString error;
+        QList<WarcRecord> read = readAll(data, error);
+        QVERIFY2(error.isEmpty(), qPrintable(error));
+        QCOMPARE(read.size(), 3);
+        QCOMPARE(read.at(0).header("WARC-Type"), QByteArray("warcinfo"));
+        QCOMPARE(read.at(1).header("warc-target-uri"), QByteArray("http://example.com/"));
+        QCOMPARE(read.at(1).block, httpResponse("", "<p>one</p>"));
+        QCOMPARE(read.at(2).block, large);
+    }
+
+    void testTruncatedRecord_data()
+    {
+        QTest::addColumn<bool>("compressed");
+        QTest::newRow("plain") << false;
+        QTest::newRow("gzip members") << true;
+    }
+
+    void testTruncatedRecord()
+    {
+        QFETCH(bool, compressed);
+        QByteArray first = warcRecord("response", "http://example.com/", httpResponse("", "<p>one</p>"));
+        // incompressible, so that cutting the compressed data also cuts the block
+        QByteArray noise(4096, '\0');
+        QRandomGenerator random(1);
+        for (char &c : noise) {
+            c = static_cast<char>(random.bounded(256));
+        }
+        QByteArray second = warcRecord("response", "http://example.com/2", httpResponse("", noise));
+        QByteArray data = compressed ? gzip(first) + gzip(second) : first + second;
+        data.chop(2000);
+
+        QString error;
+        QList<WarcRecord> read = readAll(data, error);
+        QCOMPARE(read.size(), 1);
+        QCOMPARE(read.first().header("WARC-Target-URI"), QByteArray("http://example.com/"));
+        QVERIFY(!error.isEmpty());
+    }
+
+    void testNotWarc()
+    {
+        QString error;
+        QVERIFY(readAll("<html></html>\r\n", error).isEmpty());
+        QVERIFY(!error.isEmpty());
+    }
+
+    void testHttpResponse_data()
+    {
+        QTest::addColumn<QByteArray>("block");
+        QTest::addColumn<bool>("ok");
+        QTest::addColumn<QByteArray>("body");
+
+        QByteArray html("<html><body><p>Some text</p></body></html>");
+        QTest::newRow("identity") << httpResponse("", html) << true << html;
+        QTest::newRow("chunked") << httpResponse("Transfer-Encoding: chunked\r\n",
+                                                 "10\r\n" + html.left(16) + "\r\n" +
+                                                 QByteArray::number(html.size() - 16, 16) + ";ext=1\r\n" + html.mid(16) +
+                                                 "\r\n0\r\n\r\n") << true << html;
+        QTest::newRow("gzip") << httpResponse("Content-Encoding: gzip\r\n", gzip(html)) << true << html;
+        QByteArray gzipped = gzip(html);
+        QTest::newRow("chunked gzip") << httpResponse("Transfer-Encoding: chunked\r\nContent-Encoding: gzip\r\n",
+                                                      QByteArray::number(gzipped.size(), 16) + "\r\n" + gzipped +
+                                                      "\r\n0\r\n\r\n") << true << html;
+        // qCompress output is a zlib stream behind a 4-byte length
+        QTest::newRow("deflate") << httpResponse("Content-Encoding: deflate\r\n", qCompress(html).mid(4)) << true << html;
+        QTest::newRow("truncated chunk") << httpResponse("Transfer-Encoding: chunked\r\n", "100\r\n" + html)
+                                         << true << html;
+        QTest::newRow("huge chunk size") << httpResponse("Transfer-Encoding: chunked\r\n", "7fffffff\r\n" + html)
+                                         << true << html;
+        QTest::newRow("overflowing chunk size") << httpResponse("Transfer-Encoding: chunked\r\n",
+                                                                "10\r\n" + html.left(16) + "\r\nfffffffffffffffff\r\n" + html)
+                                                << false << QByteArray();
+        QTest::newRow("unknown encoding") << httpResponse("Content-Encoding: br\r\n", html) << false << QByteArray();
+        QTest::newRow("not http") << QByteArray("<html></html>") << false << QByteArray();
+    }
+
+    void testHttpResponse()
+    {
+        QFETCH(QByteArray, block);
+        QFETCH(bool, ok);
+        QFETCH(QByteArray, body);
+        QByteArray contentType;
+        QByteArray decoded;
+        QCOMPARE(WarcReader::parseHttpResponse(block, contentType, decoded), ok);
+        if (ok) {
+            QCOMPARE(contentType, QByteArray("text/html"));
+            QCOMPARE(decoded, body);
+        }
+    }
+};
+
+QTEST_MAIN(testWarcReader)
+#include "tst_warcreader.moc"